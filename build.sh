@@ -40,11 +40,14 @@ check_command pkg-config
 
 # Check X11 libraries
 check_pkg_config x11 "sudo dnf install libX11-devel (Fedora) or sudo apt install libx11-dev (Ubuntu)"
+check_pkg_config x11-xcb "sudo dnf install libX11-devel (Fedora) or sudo apt install libx11-xcb-dev (Ubuntu)"
+check_pkg_config xcb "sudo dnf install libxcb-devel (Fedora) or sudo apt install libxcb1-dev (Ubuntu)"
 check_pkg_config xcomposite "sudo dnf install libXcomposite-devel (Fedora) or sudo apt install libxcomposite-dev (Ubuntu)"
 check_pkg_config xdamage "sudo dnf install libXdamage-devel (Fedora) or sudo apt install libxdamage-dev (Ubuntu)"
 check_pkg_config xfixes "sudo dnf install libXfixes-devel (Fedora) or sudo apt install libxfixes-dev (Ubuntu)"
 check_pkg_config xrender "sudo dnf install libXrender-devel (Fedora) or sudo apt install libxrender-dev (Ubuntu)"
 check_pkg_config xtst "sudo dnf install libXtst-devel (Fedora) or sudo apt install libxtst-dev (Ubuntu)"
+check_pkg_config xext "sudo dnf install libXext-devel (Fedora) or sudo apt install libxext-dev (Ubuntu)"
 
 # Check for Xvfb
 check_command Xvfb
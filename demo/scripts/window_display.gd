@@ -127,8 +127,9 @@ func create_window_quad(window_id: int, index: int) -> MeshInstance3D:
 	return quad
 
 func update_window_texture(quad: MeshInstance3D, window_id: int):
-	var image = compositor.get_window_buffer(window_id)
-	if not image:
+	# The compositor owns the texture and updates it in place when the window changes
+	var texture = compositor.get_window_texture(window_id)
+	if not texture:
 		return
 
 	var size = compositor.get_window_size(window_id)
@@ -151,12 +152,9 @@ func update_window_texture(quad: MeshInstance3D, window_id: int):
 			# So the collision box should match the quad size (which is now scaled)
 			box_shape.size = Vector3(1, 1, 0.01)
 
-	# Create texture from image
-	var texture = ImageTexture.create_from_image(image)
-
 	# Update material
 	var material = quad.material_override as StandardMaterial3D
-	if material:
+	if material and material.albedo_texture != texture:
 		material.albedo_texture = texture
 
 ## Spatial window management
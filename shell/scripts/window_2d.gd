@@ -300,12 +300,12 @@ func update_texture():
 	if not compositor or window_id < 0:
 		return
 
-	var image = compositor.get_window_buffer(window_id)
-	if not image:
+	# The compositor owns the texture and updates it in place when the window changes
+	var texture = compositor.get_window_texture(window_id)
+	if not texture:
 		return
 
-	var texture = ImageTexture.create_from_image(image)
-	if content_container:
+	if content_container and content_container.texture != texture:
 		content_container.texture = texture
 
 func _gui_input(event: InputEvent):
@@ -24,6 +24,12 @@ var window_2d_nodes := {}  # window_id -> Window2D
 var window_z_order := []   # Array of window_ids, front to back
 var window_directories := {}  # window_id -> directory path where window was created
 var current_filter_directory := ""  # Current directory filter (empty = show all)
+var known_window_ids := {}  # window_id -> true, kept in sync by compositor signals
+var snapshot_generation := -1  # Compositor window generation the maps below were read at
+var window_titles := {}  # window_id -> title, from the compositor's window snapshot
+var window_mapped := {}  # window_id -> bool
+var window_parent := {}  # window_id -> parent window_id (-1 for top-level windows)
+var window_positions := {}  # window_id -> Vector2i root position
 
 # Window2D scene to instantiate
 var Window2DScene = preload("res://shell/scripts/window_2d.gd")
@@ -60,6 +66,12 @@ func _ready():
 		# Listen for mode changes
 		mode_manager.mode_changed.connect(_on_mode_changed)
 
+	# Track windows through compositor signals instead of polling get_window_ids()
+	compositor.window_created.connect(_on_compositor_window_created)
+	compositor.window_destroyed.connect(_on_compositor_window_destroyed)
+	for window_id in compositor.get_window_ids():
+		known_window_ids[window_id] = true
+
 	print("Window2DManager initialized")
 
 func _process(_delta):
@@ -71,25 +83,45 @@ func _process(_delta):
 	if mode_manager and mode_manager.is_3d_mode():
 		return
 
-	# Get all current window IDs
-	var window_ids = compositor.get_window_ids()
-
-	# Remove Window2D nodes for closed windows
-	var ids_to_remove = []
-	for window_id in window_2d_nodes.keys():
-		if window_id not in window_ids:
-			ids_to_remove.append(window_id)
-
-	for window_id in ids_to_remove:
-		remove_window_2d(window_id)
-
 	# Create or update Window2D nodes for each window
-	for window_id in window_ids:
+	# (closed windows are removed by _on_compositor_window_destroyed)
+	refresh_window_snapshot()
+	for window_id in known_window_ids:
 		if window_id not in window_2d_nodes:
 			create_window_2d(window_id)
 		else:
 			update_window_2d(window_id)
 
+func refresh_window_snapshot():
+	"""Re-read window metadata in one call, and only when something changed"""
+	var generation = compositor.get_window_generation()
+	if generation == snapshot_generation:
+		return
+	snapshot_generation = generation
+
+	var snapshot = compositor.get_window_snapshot()
+	var ids: PackedInt32Array = snapshot["ids"]
+	var parents: PackedInt32Array = snapshot["parents"]
+	var rects: PackedInt32Array = snapshot["rects"]
+	var flags: PackedInt32Array = snapshot["flags"]
+	var titles: PackedStringArray = snapshot["titles"]
+	window_titles.clear()
+	window_mapped.clear()
+	window_parent.clear()
+	window_positions.clear()
+	for i in ids.size():
+		window_titles[ids[i]] = titles[i]
+		window_mapped[ids[i]] = (flags[i] & compositor.WINDOW_SNAPSHOT_MAPPED) != 0
+		window_parent[ids[i]] = parents[i]
+		window_positions[ids[i]] = Vector2i(rects[i * 4], rects[i * 4 + 1])
+
+func _on_compositor_window_created(window_id: int):
+	known_window_ids[window_id] = true
+
+func _on_compositor_window_destroyed(window_id: int):
+	known_window_ids.erase(window_id)
+	remove_window_2d(window_id)
+
 func create_window_2d(window_id: int):
 	"""Create a new Window2D node for an X11 window"""
 	if not container:
@@ -133,12 +165,12 @@ func create_window_2d(window_id: int):
 	var window_position: Vector2i
 
 	# Check if this window is a popup (has a parent window)
-	var parent_window_id = compositor.get_parent_window_id(window_id)
+	var parent_window_id = window_parent.get(window_id, -1)
 	if parent_window_id != -1 and parent_window_id in window_2d_nodes:
 		# This is a popup - position it relative to parent window
 		var parent_window_2d = window_2d_nodes[parent_window_id]
-		var popup_x11_pos = compositor.get_window_position(window_id)
-		var parent_x11_pos = compositor.get_window_position(parent_window_id)
+		var popup_x11_pos = window_positions.get(window_id, Vector2i.ZERO)
+		var parent_x11_pos = window_positions.get(parent_window_id, Vector2i.ZERO)
 
 		# Calculate offset from parent window in X11 space
 		var offset_x = popup_x11_pos.x - parent_x11_pos.x
@@ -234,11 +266,11 @@ func update_window_2d(window_id: int):
 	var window_2d = window_2d_nodes[window_id]
 
 	# Update window title
-	var window_title = compositor.get_window_title(window_id)
+	var window_title = window_titles.get(window_id, "")
 	window_2d.set_window_title(window_title)
 
 	# Check if window should be shown/hidden based on mapped state AND directory filter
-	var is_mapped = compositor.is_window_mapped(window_id)
+	var is_mapped = window_mapped.get(window_id, false)
 	var window_dir = window_directories.get(window_id, "")
 
 	# Respect directory filtering
@@ -252,15 +284,21 @@ func update_window_2d(window_id: int):
 	else:
 		window_2d.visible = true
 
+	# Minimized and filtered-out windows aren't captured until they're shown again
+	if window_2d.is_minimized or not passes_directory_filter:
+		compositor.set_window_interest(window_id, compositor.WINDOW_INTEREST_HIDDEN)
+	else:
+		compositor.set_window_interest(window_id, compositor.WINDOW_INTEREST_VISIBLE)
+
 	# Update popup position if this is a popup window (follows parent)
-	var parent_window_id = compositor.get_parent_window_id(window_id)
+	var parent_window_id = window_parent.get(window_id, -1)
 	if parent_window_id != -1 and parent_window_id in window_2d_nodes:
 		var parent_window_2d = window_2d_nodes[parent_window_id]
 
 		# Don't update position if parent (or any ancestor) is being dragged
 		if not _is_window_or_ancestor_dragging(parent_window_id):
-			var popup_x11_pos = compositor.get_window_position(window_id)
-			var parent_x11_pos = compositor.get_window_position(parent_window_id)
+			var popup_x11_pos = window_positions.get(window_id, Vector2i.ZERO)
+			var parent_x11_pos = window_positions.get(parent_window_id, Vector2i.ZERO)
 
 			# Calculate offset from parent window in X11 space
 			var offset_x = popup_x11_pos.x - parent_x11_pos.x
@@ -290,7 +328,7 @@ func _is_window_or_ancestor_dragging(window_id: int) -> bool:
 				return true
 
 		# Check parent
-		var parent_id = compositor.get_parent_window_id(current_id)
+		var parent_id = window_parent.get(current_id, -1)
 		if parent_id == -1:
 			break
 
@@ -370,6 +408,7 @@ func update_z_order():
 
 func _build_z_order_with_popups() -> Array:
 	"""Build Z-order list ensuring popups are above their parents"""
+	refresh_window_snapshot()  # Also called from focus changes, outside _process
 	var result = []
 	var processed = {}
 
@@ -382,7 +421,7 @@ func _build_z_order_with_popups() -> Array:
 
 		# Add all popup children of this window
 		for child_id in window_2d_nodes:
-			var parent_id = compositor.get_parent_window_id(child_id)
+			var parent_id = window_parent.get(child_id, -1)
 			if parent_id == window_id:
 				_add_func_ref.call(child_id, _add_func_ref)
 
@@ -390,7 +429,7 @@ func _build_z_order_with_popups() -> Array:
 	for i in range(window_z_order.size() - 1, -1, -1):
 		var window_id = window_z_order[i]
 		# Only add root windows (windows without parents or whose parents aren't tracked)
-		var parent_id = compositor.get_parent_window_id(window_id)
+		var parent_id = window_parent.get(window_id, -1)
 		if parent_id == -1 or parent_id not in window_2d_nodes:
 			add_window_with_popups.call(window_id, add_window_with_popups)
 
@@ -9,12 +9,20 @@ extends Node3D
 @export var update_rate := 60.0  # Updates per second
 @export var spawn_distance := 3.0  # Distance from player to spawn new windows
 @export var pixels_per_world_unit := 400.0  # Conversion factor: 400 pixels = 1 world unit
+@export var thumbnail_distance := 8.0  # Beyond this distance from the camera, quads show the thumbnail
+@export var lod_full_rate_distance := 4.0  # Windows further than this are captured at a reduced frame rate
+@export var lod_min_fps := 10.0  # Lowest capture rate for distant windows
 
 var compositor: Node
 var camera: Camera3D
 var filesystem_generator: Node
 var mode_manager: Node = null
 var window_quads := {}  # Maps window_id -> MeshInstance3D
+var known_window_ids := {}  # window_id -> true, kept in sync by compositor signals
+var snapshot_generation := -1  # Compositor window generation the maps below were read at
+var window_mapped := {}  # window_id -> bool, from the compositor's window snapshot
+var window_parent := {}  # window_id -> parent window_id (-1 for top-level windows)
+var window_lod_limited := {}  # window_id -> true while it has a reduced capture LOD set
 var update_timer := 0.0
 var next_z_offset := 0.0  # Z offset for each window to prevent Z-fighting
 
@@ -53,6 +61,12 @@ func _ready():
 	if mode_manager:
 		mode_manager.mode_changed.connect(_on_mode_changed)
 
+	# Track windows through compositor signals instead of polling get_window_ids()
+	compositor.window_created.connect(_on_compositor_window_created)
+	compositor.window_destroyed.connect(_on_compositor_window_destroyed)
+	for window_id in compositor.get_window_ids():
+		known_window_ids[window_id] = true
+
 	print("WindowDisplay ready, connected to compositor: ", compositor.get_display_name())
 
 func _process(delta):
@@ -70,17 +84,9 @@ func _process(delta):
 		return
 	update_timer = 0.0
 
-	# Get all current window IDs
-	var window_ids = compositor.get_window_ids()
-
-	# Remove quads for windows that no longer exist
-	var ids_to_remove = []
-	for window_id in window_quads.keys():
-		if window_id not in window_ids:
-			ids_to_remove.append(window_id)
-
-	for window_id in ids_to_remove:
-		remove_window_quad(window_id)
+	# Windows that closed are removed by _on_compositor_window_destroyed
+	var window_ids = known_window_ids.keys()
+	refresh_window_snapshot()
 
 	# Get current room for filtering
 	var current_room_path = ""
@@ -108,9 +114,22 @@ func _process(delta):
 		var in_current_room = (window_room_path == current_room_path or window_room_path == "")
 
 		# Hide unmapped windows OR windows not in current room
-		var is_mapped = compositor.is_window_mapped(window_id)
+		var is_mapped = window_mapped.get(window_id, false)
 		quad.visible = is_mapped and in_current_room
 
+		# Windows in other rooms aren't captured until we come back, and distant
+		# windows only need a low-rate thumbnail
+		var use_thumbnail = camera and camera.global_position.distance_to(quad.global_position) > thumbnail_distance
+		if not in_current_room:
+			compositor.set_window_interest(window_id, compositor.WINDOW_INTEREST_HIDDEN)
+			clear_window_lod(window_id)
+		elif use_thumbnail:
+			compositor.set_window_interest(window_id, compositor.WINDOW_INTEREST_THUMBNAIL)
+			clear_window_lod(window_id)
+		else:
+			compositor.set_window_interest(window_id, compositor.WINDOW_INTEREST_VISIBLE)
+			update_window_lod(quad, window_id, window_id == selected_window_id)
+
 		# Disable collision for unmapped windows or windows not in current room
 		var static_body = quad.get_node_or_null("StaticBody3D")
 		if static_body:
@@ -120,12 +139,12 @@ func _process(delta):
 
 		# Only update texture for mapped windows in current room
 		if is_mapped and in_current_room:
-			update_window_texture(quad, window_id)
+			update_window_texture(quad, window_id, use_thumbnail)
 
 			# Billboard behavior: Make idle windows face the camera
 			# Skip billboarding for popup windows (they follow parent orientation)
 			# Keep billboarding selected window until we're in 2D mode (so it stays aligned during camera animation)
-			var parent_id = compositor.get_parent_window_id(window_id)
+			var parent_id = window_parent.get(window_id, -1)
 			var is_selected = (window_id == selected_window_id)
 			var in_2d_mode = window_interaction and window_interaction.get("in_2d_mode")
 
@@ -135,6 +154,23 @@ func _process(delta):
 				var look_angle = atan2(to_camera.x, to_camera.z)
 				quad.rotation.y = look_angle
 
+func refresh_window_snapshot():
+	"""Re-read window metadata in one call, and only when something changed"""
+	var generation = compositor.get_window_generation()
+	if generation == snapshot_generation:
+		return
+	snapshot_generation = generation
+
+	var snapshot = compositor.get_window_snapshot()
+	var ids: PackedInt32Array = snapshot["ids"]
+	var parents: PackedInt32Array = snapshot["parents"]
+	var flags: PackedInt32Array = snapshot["flags"]
+	window_mapped.clear()
+	window_parent.clear()
+	for i in ids.size():
+		window_mapped[ids[i]] = (flags[i] & compositor.WINDOW_SNAPSHOT_MAPPED) != 0
+		window_parent[ids[i]] = parents[i]
+
 func create_window_quad(window_id: int, index: int) -> MeshInstance3D:
 	var quad = MeshInstance3D.new()
 	add_child(quad)
@@ -176,9 +212,50 @@ func create_window_quad(window_id: int, index: int) -> MeshInstance3D:
 
 	return quad
 
-func update_window_texture(quad: MeshInstance3D, window_id: int):
-	var image = compositor.get_window_buffer(window_id)
-	if not image:
+func update_window_lod(quad: MeshInstance3D, window_id: int, full_detail: bool):
+	"""Capture windows at roughly the resolution and rate they are seen at from the camera"""
+	var max_pixels = 0
+	var max_fps = 0.0
+
+	if camera and not full_detail:
+		var size = compositor.get_window_size(window_id)
+		var distance = camera.global_position.distance_to(quad.global_position)
+
+		# Height of the quad on screen, in pixels
+		var visible_height = 2.0 * distance * tan(deg_to_rad(camera.fov) * 0.5)
+		var screen_height = get_viewport().get_visible_rect().size.y * quad.scale.y / max(visible_height, 0.001)
+
+		# Halve the resolution while it stays above what's on screen. Power-of-two steps
+		# keep the texture from being reallocated every frame while the camera moves.
+		var scale = 1.0
+		while scale > 0.125 and size.y * scale * 0.5 >= screen_height:
+			scale *= 0.5
+		if scale < 1.0:
+			max_pixels = int(size.x * size.y * scale * scale)
+
+		if distance > lod_full_rate_distance:
+			max_fps = max(lod_min_fps, update_rate * lod_full_rate_distance / distance)
+
+	compositor.set_window_lod(window_id, max_pixels, max_fps)
+	if max_pixels > 0 or max_fps > 0.0:
+		window_lod_limited[window_id] = true
+	else:
+		window_lod_limited.erase(window_id)
+
+func clear_window_lod(window_id: int):
+	"""Back to full resolution and rate; a LOD only makes sense while this script places the quad"""
+	if window_lod_limited.has(window_id):
+		compositor.set_window_lod(window_id, 0, 0)
+		window_lod_limited.erase(window_id)
+
+func update_window_texture(quad: MeshInstance3D, window_id: int, use_thumbnail := false):
+	# The compositor owns the texture and updates it in place when the window changes
+	var texture = null
+	if use_thumbnail:
+		texture = compositor.get_window_thumbnail(window_id)
+	if not texture:
+		texture = compositor.get_window_texture(window_id)
+	if not texture:
 		return
 
 	var size = compositor.get_window_size(window_id)
@@ -201,12 +278,9 @@ func update_window_texture(quad: MeshInstance3D, window_id: int):
 			# Make it 4x larger to ensure all edges are always clickable
 			box_shape.size = Vector3(4.0, 4.0, 0.02)
 
-	# Create texture from image
-	var texture = ImageTexture.create_from_image(image)
-
 	# Update material
 	var material = quad.material_override as StandardMaterial3D
-	if material:
+	if material and material.albedo_texture != texture:
 		material.albedo_texture = texture
 
 ## Spatial window management
@@ -257,6 +331,10 @@ func create_window_quad_spatial(window_id: int) -> MeshInstance3D:
 	else:
 		material.albedo_color = Color(1, 1, 1, 1)
 
+	# ARGB windows (tooltips, rounded menus, translucent terminals) need blending
+	if compositor.is_window_transparent(window_id):
+		material.transparency = BaseMaterial3D.TRANSPARENCY_ALPHA
+
 	quad.material_override = material
 
 	# Add collision shape for raycasting
@@ -657,10 +735,21 @@ func restore_window_states_3d(states: Dictionary):
 
 	print("  Restored ", restored_count, " windows to 3D positions")
 
+func _on_compositor_window_created(window_id: int):
+	known_window_ids[window_id] = true
+
+func _on_compositor_window_destroyed(window_id: int):
+	known_window_ids.erase(window_id)
+	window_lod_limited.erase(window_id)
+	remove_window_quad(window_id)
+
 func _on_mode_changed(new_mode):
 	"""Handle mode changes"""
 	if mode_manager and mode_manager.is_2d_mode():
 		# Hide all 3D quads in 2D mode
 		for quad in window_quads.values():
 			quad.visible = false
+		# 2D windows are shown at full size, so drop the distance-based LODs
+		for window_id in window_lod_limited.keys():
+			clear_window_lod(window_id)
 	# Note: Don't call organize_windows_3d() here - mode_manager handles restore/organize
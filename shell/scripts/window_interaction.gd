@@ -540,12 +540,16 @@ func check_and_adjust_for_popups():
 	if not compositor or selected_window_id == -1:
 		return
 
-	# Get all window IDs and find popups for the selected window
-	var window_ids = compositor.get_window_ids()
+	# Find popups for the selected window (one snapshot instead of per-window queries)
+	var snapshot = compositor.get_window_snapshot()
+	var ids: PackedInt32Array = snapshot["ids"]
+	var parents: PackedInt32Array = snapshot["parents"]
+	var flags: PackedInt32Array = snapshot["flags"]
 	var current_popups = []
 
-	for wid in window_ids:
-		var parent_id = compositor.get_parent_window_id(wid)
+	for i in ids.size():
+		var wid = ids[i]
+		var parent_id = parents[i]
 
 		# Also check for logical parent (orphan dialogs associated with selected window)
 		var window_display = get_node_or_null("/root/Main/WindowDisplay")
@@ -557,7 +561,7 @@ func check_and_adjust_for_popups():
 					parent_id = quad.get_meta("logical_parent_id")
 
 		# Check if this is a popup of the selected window and is visible/mapped
-		if parent_id == selected_window_id and compositor.is_window_mapped(wid):
+		if parent_id == selected_window_id and (flags[i] & compositor.WINDOW_SNAPSHOT_MAPPED) != 0:
 			current_popups.append(wid)
 
 	# Check if popup list has changed
@@ -12,6 +12,10 @@ var compositor: Node
 var filesystem_generator: Node
 var window_display: Node
 var player: Node3D
+var snapshot_generation := -1  # Compositor window generation the maps below were read at
+var window_mapped := {}  # window_id -> bool, from the compositor's window snapshot
+var window_titles := {}  # window_id -> title
+var window_classes := {}  # window_id -> WM_CLASS
 
 # UI references
 var taskbar_container: HBoxContainer
@@ -94,14 +98,15 @@ func update_taskbar():
 		return
 
 	var current_room_path = current_room.directory_path
+	refresh_window_snapshot()
 
-	# Get all windows and filter by room
-	var window_ids = compositor.get_window_ids()
+	# Filter windows by room (window_display keeps window_quads in sync with
+	# the compositor's window_created/window_destroyed signals)
 	var room_windows = []
 
-	for window_id in window_ids:
+	for window_id in window_display.window_quads:
 		# Check if window is mapped (not closed)
-		if not compositor.is_window_mapped(window_id):
+		if not window_mapped.get(window_id, false):
 			continue
 
 		# Check if window belongs to current room
@@ -120,10 +125,31 @@ func update_taskbar():
 			if i < taskbar_container.get_child_count():
 				var button = taskbar_container.get_child(i) as Button
 				if button:
-					var window_title = compositor.get_window_title(window_id)
-					var window_class = compositor.get_window_class(window_id)
+					var window_title = window_titles.get(window_id, "")
+					var window_class = window_classes.get(window_id, "")
 					button.text = window_class if window_class != "" else window_title
 					button.set_meta("window_id", window_id)
+					update_button_preview(button, window_id)
+
+func refresh_window_snapshot():
+	"""Re-read window metadata in one call, and only when something changed"""
+	var generation = compositor.get_window_generation()
+	if generation == snapshot_generation:
+		return
+	snapshot_generation = generation
+
+	var snapshot = compositor.get_window_snapshot()
+	var ids: PackedInt32Array = snapshot["ids"]
+	var flags: PackedInt32Array = snapshot["flags"]
+	var titles: PackedStringArray = snapshot["titles"]
+	var classes: PackedStringArray = snapshot["classes"]
+	window_mapped.clear()
+	window_titles.clear()
+	window_classes.clear()
+	for i in ids.size():
+		window_mapped[ids[i]] = (flags[i] & compositor.WINDOW_SNAPSHOT_MAPPED) != 0
+		window_titles[ids[i]] = titles[i]
+		window_classes[ids[i]] = classes[i]
 
 func rebuild_taskbar(window_ids: Array):
 	# Clear existing buttons
@@ -138,14 +164,17 @@ func create_window_button(window_id: int):
 	var button = Button.new()
 	taskbar_container.add_child(button)
 
-	var window_title = compositor.get_window_title(window_id)
-	var window_class = compositor.get_window_class(window_id)
+	var window_title = window_titles.get(window_id, "")
+	var window_class = window_classes.get(window_id, "")
 
 	# Use class name for button text, fallback to title
 	button.text = window_class if window_class != "" else window_title
 	button.custom_minimum_size = Vector2(150, 40)
+	button.expand_icon = true
+	button.add_theme_constant_override("icon_max_width", 64)
 	button.tooltip_text = window_title
 	button.set_meta("window_id", window_id)
+	update_button_preview(button, window_id)
 
 	# Connect click to teleport
 	button.pressed.connect(func(): teleport_to_window(window_id))
@@ -156,6 +185,12 @@ func create_window_button(window_id: int):
 		# Selected window - highlight
 		button.add_theme_color_override("font_color", Color(0.3, 1.0, 1.0))
 
+func update_button_preview(button: Button, window_id: int):
+	# Small live preview from the compositor's thumbnail channel
+	var thumbnail = compositor.get_window_thumbnail(window_id)
+	if thumbnail and button.icon != thumbnail:
+		button.icon = thumbnail
+
 func teleport_to_window(window_id: int):
 	if not window_display or not player:
 		return
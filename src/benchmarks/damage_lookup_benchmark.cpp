@@ -0,0 +1,81 @@
+// Standalone damage lookup benchmark: a synthetic damage storm over 200 windows
+// with XID-like damage handles, looked up the way handle_damage_notify used to
+// (linear scan of the window table), through a std::map keyed by damage handle,
+// and through the FlatHashMap index the compositor uses now.
+//
+//   scons benchmarks && ./bin/damage_lookup_benchmark
+
+#include "flat_hash_map.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+using namespace godot;
+
+// Just the fields a damage lookup touches
+struct FakeWindow {
+    int id;
+    unsigned long damage;
+};
+
+int main() {
+    const int WINDOW_COUNT = 200;
+    const int EVENT_COUNT = 1000000;
+
+    std::vector<FakeWindow> windows(WINDOW_COUNT);
+    std::map<int, FakeWindow*> table;
+    std::map<unsigned long, FakeWindow*> tree_index;
+    FlatHashMap<unsigned long, FakeWindow*> index;
+    for (int i = 0; i < WINDOW_COUNT; i++) {
+        windows[i].id = i + 1;
+        windows[i].damage = 0x00400001 + i * 7;
+        table[windows[i].id] = &windows[i];
+        tree_index[windows[i].damage] = &windows[i];
+        index[windows[i].damage] = &windows[i];
+    }
+
+    // Pseudo-random event order so neither lookup gets lucky with the cache
+    std::vector<unsigned long> events(EVENT_COUNT);
+    uint32_t seed = 12345;
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        events[i] = windows[(seed >> 8) % WINDOW_COUNT].damage;
+    }
+
+    int hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long damage : events) {
+        for (const auto &pair : table) {
+            if (pair.second->damage == damage) {
+                hits++;
+                break;
+            }
+        }
+    }
+    double linear_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / EVENT_COUNT;
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned long damage : events) {
+        if (tree_index.find(damage) != tree_index.end()) {
+            hits++;
+        }
+    }
+    double tree_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / EVENT_COUNT;
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned long damage : events) {
+        if (index.find(damage) != index.end()) {
+            hits++;
+        }
+    }
+    double hashed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / EVENT_COUNT;
+
+    printf("Damage lookup, %d windows, %d events (%d hits)\n", WINDOW_COUNT, EVENT_COUNT, hits);
+    printf("  linear scan  %6.1f ns/event\n", linear_ns);
+    printf("  std::map     %6.1f ns/event\n", tree_ns);
+    printf("  FlatHashMap  %6.1f ns/event\n", hashed_ns);
+    return 0;
+}
@@ -0,0 +1,33 @@
+// Standalone pixel conversion benchmark: converts a 4K frame with every kernel
+// this CPU supports and prints the throughput of each.
+//
+//   scons benchmarks && ./bin/pixel_convert_benchmark [width height iterations]
+
+#include "pixel_convert.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace godot;
+
+int main(int argc, char **argv) {
+    int width = 3840;
+    int height = 2160;
+    int iterations = 20;
+    if (argc == 4) {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+        iterations = atoi(argv[3]);
+    }
+    if (width <= 0 || height <= 0 || iterations <= 0) {
+        fprintf(stderr, "usage: %s [width height iterations]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Pixel conversion, %dx%d, %d iterations\n", width, height, iterations);
+    for (const PixelConvertBenchmark &result : pixel_convert_benchmark(width, height, iterations)) {
+        printf("  %-8s %-22s %6.2f GB/s\n", result.kernel, pixel_format_name(result.format),
+               result.gigabytes_per_second);
+    }
+    return 0;
+}
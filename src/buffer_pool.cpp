@@ -0,0 +1,116 @@
+#include "buffer_pool.hpp"
+
+#include <cstdlib>
+
+namespace godot {
+
+BufferPool::~BufferPool() {
+    for (auto &pair : free_lists) {
+        for (uint8_t *buffer : pair.second) {
+            free(buffer);
+        }
+    }
+}
+
+BufferPool &BufferPool::shared() {
+    static BufferPool pool;
+    return pool;
+}
+
+size_t BufferPool::round_size(size_t size) {
+    size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages <= 4) {
+        return (pages ? pages : 1) * PAGE_SIZE;
+    }
+
+    // Four classes per power of two: 2^k, 1.25 * 2^k, 1.5 * 2^k, 1.75 * 2^k pages
+    int bits = 0;
+    while ((pages >> bits) > 1) {
+        bits++;
+    }
+    size_t step = (size_t)1 << (bits - 2);
+    return ((pages + step - 1) / step) * step * PAGE_SIZE;
+}
+
+uint8_t *BufferPool::acquire(size_t size, size_t *capacity) {
+    size_t rounded = round_size(size);
+    *capacity = rounded;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = free_lists.find(rounded);
+        if (it != free_lists.end() && !it->second.empty()) {
+            uint8_t *buffer = it->second.back();
+            it->second.pop_back();
+            idle_bytes -= rounded;
+            outstanding_bytes += rounded;
+            hits++;
+            return buffer;
+        }
+    }
+
+    // Page alignment keeps rows SIMD-aligned and lets the buffer back an SHM image
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, PAGE_SIZE, rounded) != 0) {
+        *capacity = 0;
+        return nullptr;
+    }
+    outstanding_bytes += rounded;
+    misses++;
+    return (uint8_t*)buffer;
+}
+
+void BufferPool::release(uint8_t *buffer, size_t capacity) {
+    if (!buffer) {
+        return;
+    }
+    outstanding_bytes -= capacity;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle_bytes + capacity <= max_idle_bytes) {
+            free_lists[capacity].push_back(buffer);
+            idle_bytes += capacity;
+            return;
+        }
+    }
+    free(buffer);
+}
+
+void BufferPool::set_max_idle_bytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    max_idle_bytes = bytes;
+
+    // Trim right away rather than waiting for the next release
+    for (auto &pair : free_lists) {
+        while (idle_bytes > max_idle_bytes && !pair.second.empty()) {
+            free(pair.second.back());
+            pair.second.pop_back();
+            idle_bytes -= pair.first;
+        }
+    }
+}
+
+void PooledBuffer::allocate(size_t size) {
+    // Keep the current buffer unless it's too small, or four times too big
+    if (buffer && size <= allocated && size * 4 >= allocated) {
+        used = size;
+        return;
+    }
+
+    release();
+    if (size == 0) {
+        return;
+    }
+    buffer = BufferPool::shared().acquire(size, &allocated);
+    used = buffer ? size : 0;
+}
+
+void PooledBuffer::release() {
+    BufferPool::shared().release(buffer, allocated);
+    buffer = nullptr;
+    used = 0;
+    allocated = 0;
+}
+
+} // namespace godot
@@ -0,0 +1,89 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include "flat_hash_map.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace godot {
+
+// Recycles page-aligned frame buffers by size class, so windows that resize
+// (or get captured at a new LOD) reuse memory instead of going through malloc
+// on every frame. Size classes are whole pages, with four steps per power of two,
+// so a buffer is never more than 25% larger than asked for and a window edge
+// dragged a few pixels at a time usually stays within the same class.
+class BufferPool {
+public:
+    static const size_t PAGE_SIZE = 4096;
+    static const size_t DEFAULT_MAX_IDLE_BYTES = 128 * 1024 * 1024;
+
+    BufferPool() {}
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // The pool shared by all window captures
+    static BufferPool &shared();
+
+    // Size class `size` rounds up to (also used to size MIT-SHM segments)
+    static size_t round_size(size_t size);
+
+    // Page-aligned buffer of at least `size` bytes; *capacity receives its
+    // actual size, which must be passed back to release()
+    uint8_t *acquire(size_t size, size_t *capacity);
+    void release(uint8_t *buffer, size_t capacity);
+
+    // Free buffers above this many idle bytes instead of keeping them
+    void set_max_idle_bytes(size_t bytes);
+
+    uint64_t get_hits() const { return hits; }
+    uint64_t get_misses() const { return misses; }
+    uint64_t get_idle_bytes() const { return idle_bytes; }
+    uint64_t get_outstanding_bytes() const { return outstanding_bytes; }
+
+private:
+    std::mutex mutex;
+    FlatHashMap<size_t, std::vector<uint8_t*>> free_lists;  // Size class -> idle buffers
+    size_t max_idle_bytes = DEFAULT_MAX_IDLE_BYTES;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> idle_bytes{0};
+    std::atomic<uint64_t> outstanding_bytes{0};
+};
+
+// Owning handle to a buffer from BufferPool::shared(). Unlike std::vector,
+// allocate() doesn't preserve contents: frames are always rewritten in full
+// after a resize, so copying the old pixels over would be wasted work.
+class PooledBuffer {
+public:
+    PooledBuffer() {}
+    ~PooledBuffer() { release(); }
+
+    PooledBuffer(const PooledBuffer &) = delete;
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+    // Make room for `size` bytes. The current buffer is kept if it's big enough
+    // and not wastefully large, otherwise it goes back to the pool for another.
+    void allocate(size_t size);
+    void release();
+
+    uint8_t *data() { return buffer; }
+    const uint8_t *data() const { return buffer; }
+    size_t size() const { return used; }
+    size_t capacity() const { return allocated; }
+    bool empty() const { return used == 0; }
+
+private:
+    uint8_t *buffer = nullptr;
+    size_t used = 0;
+    size_t allocated = 0;
+};
+
+} // namespace godot
+
+#endif // BUFFER_POOL_HPP
@@ -0,0 +1,189 @@
+#ifndef FLAT_HASH_MAP_HPP
+#define FLAT_HASH_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace godot {
+
+// Hash for integer keys (window IDs, X11 XIDs). XIDs share their high bits per
+// client, so mix everything down before masking to the table size.
+template <typename K>
+struct FlatHashMapHash {
+    size_t operator()(K key) const {
+        uint64_t x = (uint64_t)key;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return (size_t)x;
+    }
+};
+
+// Open-addressing hash map with linear probing, for small integer-keyed tables
+// that are looked up on every X event. Entries live in one contiguous array, so a
+// lookup is usually a single cache line. Mirrors the parts of the std::map
+// interface the compositor uses (find/end/operator[]/erase, pairs with first/second).
+// Iteration order is unspecified, and erase invalidates iterators.
+template <typename K, typename V, typename Hash = FlatHashMapHash<K>>
+class FlatHashMap {
+public:
+    typedef std::pair<K, V> value_type;
+
+    template <typename Map, typename Value>
+    class Iterator {
+    public:
+        Iterator(Map *p_map, size_t p_index) : map(p_map), index(p_index) { skip_empty(); }
+
+        Value &operator*() const { return map->slots[index]; }
+        Value *operator->() const { return &map->slots[index]; }
+        Iterator &operator++() { index++; skip_empty(); return *this; }
+        bool operator==(const Iterator &other) const { return index == other.index; }
+        bool operator!=(const Iterator &other) const { return index != other.index; }
+
+    private:
+        friend class FlatHashMap;
+
+        void skip_empty() {
+            while (index < map->slots.size() && !map->used[index]) {
+                index++;
+            }
+        }
+
+        Map *map;
+        size_t index;
+    };
+
+    typedef Iterator<FlatHashMap, value_type> iterator;
+    typedef Iterator<const FlatHashMap, const value_type> const_iterator;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, slots.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots.size()); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    iterator find(const K &key) {
+        size_t index = find_index(key);
+        return index == NOT_FOUND ? end() : iterator(this, index);
+    }
+
+    const_iterator find(const K &key) const {
+        size_t index = find_index(key);
+        return index == NOT_FOUND ? end() : const_iterator(this, index);
+    }
+
+    V &operator[](const K &key) {
+        size_t index = find_index(key);
+        if (index != NOT_FOUND) {
+            return slots[index].second;
+        }
+
+        // Keep the load factor at or below 1/2 so probe chains stay short
+        if ((count + 1) * 2 > slots.size()) {
+            rehash(slots.empty() ? 16 : slots.size() * 2);
+        }
+
+        index = Hash()(key) & mask;
+        while (used[index]) {
+            index = (index + 1) & mask;
+        }
+        slots[index] = value_type(key, V());
+        used[index] = 1;
+        count++;
+        return slots[index].second;
+    }
+
+    size_t erase(const K &key) {
+        size_t hole = find_index(key);
+        if (hole == NOT_FOUND) {
+            return 0;
+        }
+
+        // Backward-shift deletion: pull later entries of the probe chain into the
+        // hole so lookups never need tombstones
+        used[hole] = 0;
+        count--;
+        size_t index = hole;
+        while (true) {
+            index = (index + 1) & mask;
+            if (!used[index]) {
+                break;
+            }
+
+            size_t home = Hash()(slots[index].first) & mask;
+            // Entry can move if its home slot is not cyclically within (hole, index]
+            bool stays = (hole <= index) ? (hole < home && home <= index)
+                                         : (hole < home || home <= index);
+            if (!stays) {
+                slots[hole] = std::move(slots[index]);
+                used[hole] = 1;
+                used[index] = 0;
+                hole = index;
+            }
+        }
+
+        slots[hole] = value_type();  // Release whatever the vacated slot held
+        return 1;
+    }
+
+    void clear() {
+        slots.clear();
+        used.clear();
+        count = 0;
+        mask = 0;
+    }
+
+private:
+    static const size_t NOT_FOUND = (size_t)-1;
+
+    size_t find_index(const K &key) const {
+        if (count == 0) {
+            return NOT_FOUND;
+        }
+
+        size_t index = Hash()(key) & mask;
+        while (used[index]) {
+            if (slots[index].first == key) {
+                return index;
+            }
+            index = (index + 1) & mask;
+        }
+        return NOT_FOUND;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<value_type> old_slots;
+        std::vector<uint8_t> old_used;
+        old_slots.swap(slots);
+        old_used.swap(used);
+
+        slots.resize(capacity);
+        used.assign(capacity, 0);
+        mask = capacity - 1;
+
+        for (size_t i = 0; i < old_slots.size(); i++) {
+            if (!old_used[i]) {
+                continue;
+            }
+            size_t index = Hash()(old_slots[i].first) & mask;
+            while (used[index]) {
+                index = (index + 1) & mask;
+            }
+            slots[index] = std::move(old_slots[i]);
+            used[index] = 1;
+        }
+    }
+
+    std::vector<value_type> slots;
+    std::vector<uint8_t> used;
+    size_t count = 0;
+    size_t mask = 0;
+};
+
+} // namespace godot
+
+#endif // FLAT_HASH_MAP_HPP
@@ -0,0 +1,101 @@
+#include "frame_codec.hpp"
+
+#include <cstring>
+
+namespace godot {
+
+static const uint32_t FRAME_CODEC_RUN = 0x80000000u;
+static const uint32_t FRAME_CODEC_MAX_COUNT = 0x7FFFFFFFu;
+
+// Runs shorter than this cost more as their own header than as literals
+static const size_t FRAME_CODEC_MIN_RUN = 3;
+
+static inline uint32_t load_pixel(const uint8_t *pixels, size_t index) {
+    uint32_t p;
+    memcpy(&p, pixels + index * 4, 4);
+    return p;
+}
+
+static inline void append_u32(std::vector<uint8_t> &out, uint32_t value) {
+    size_t offset = out.size();
+    out.resize(offset + 4);
+    memcpy(out.data() + offset, &value, 4);
+}
+
+void frame_compress(const uint8_t *pixels, size_t pixel_count, std::vector<uint8_t> &out) {
+    out.clear();
+
+    size_t literal_start = 0;
+    size_t i = 0;
+    while (i < pixel_count) {
+        // Measure the run starting here
+        uint32_t p = load_pixel(pixels, i);
+        size_t run = 1;
+        while (i + run < pixel_count && run < FRAME_CODEC_MAX_COUNT && load_pixel(pixels, i + run) == p) {
+            run++;
+        }
+
+        if (run < FRAME_CODEC_MIN_RUN && i - literal_start + run < FRAME_CODEC_MAX_COUNT) {
+            i += run;
+            continue;
+        }
+
+        // Flush pending literals, then the run
+        if (i > literal_start) {
+            append_u32(out, (uint32_t)(i - literal_start));
+            size_t offset = out.size();
+            out.resize(offset + (i - literal_start) * 4);
+            memcpy(out.data() + offset, pixels + literal_start * 4, (i - literal_start) * 4);
+        }
+        if (run >= FRAME_CODEC_MIN_RUN) {
+            append_u32(out, FRAME_CODEC_RUN | (uint32_t)run);
+            append_u32(out, p);
+            i += run;
+        }
+        literal_start = i;
+    }
+
+    if (pixel_count > literal_start) {
+        append_u32(out, (uint32_t)(pixel_count - literal_start));
+        size_t offset = out.size();
+        out.resize(offset + (pixel_count - literal_start) * 4);
+        memcpy(out.data() + offset, pixels + literal_start * 4, (pixel_count - literal_start) * 4);
+    }
+}
+
+bool frame_decompress(const uint8_t *data, size_t size, uint8_t *pixels, size_t pixel_count) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in + 4 <= size) {
+        uint32_t header;
+        memcpy(&header, data + in, 4);
+        in += 4;
+
+        size_t count = header & FRAME_CODEC_MAX_COUNT;
+        if (count > pixel_count - out) {
+            return false;
+        }
+
+        if (header & FRAME_CODEC_RUN) {
+            if (in + 4 > size) {
+                return false;
+            }
+            uint32_t p;
+            memcpy(&p, data + in, 4);
+            in += 4;
+            for (size_t j = 0; j < count; j++) {
+                memcpy(pixels + (out + j) * 4, &p, 4);
+            }
+        } else {
+            if (in + count * 4 > size) {
+                return false;
+            }
+            memcpy(pixels + out * 4, data + in, count * 4);
+            in += count * 4;
+        }
+        out += count;
+    }
+    return in == size && out == pixel_count;
+}
+
+} // namespace godot
@@ -0,0 +1,24 @@
+#ifndef FRAME_CODEC_HPP
+#define FRAME_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace godot {
+
+// Fast lossless codec for parking RGBA8 frames of windows nobody is looking at.
+// Window contents are mostly flat UI, so runs of identical pixels go a long way:
+// the stream is a sequence of 32-bit headers, each followed by either one pixel
+// repeated (FRAME_CODEC_RUN set) or that many literal pixels.
+
+// Compress pixel_count RGBA8 pixels into `out` (replacing its contents)
+void frame_compress(const uint8_t *pixels, size_t pixel_count, std::vector<uint8_t> &out);
+
+// Decompress into exactly pixel_count pixels. Returns false if the data is
+// malformed or doesn't decode to that many pixels.
+bool frame_decompress(const uint8_t *data, size_t size, uint8_t *pixels, size_t pixel_count);
+
+} // namespace godot
+
+#endif // FRAME_CODEC_HPP
@@ -0,0 +1,163 @@
+#include "key_map.hpp"
+#include "flat_hash_map.hpp"
+
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <cstring>
+
+namespace godot {
+
+// Godot 4 special keys (KEY_SPECIAL | index) and the X keysyms they stand for.
+// Godot KEY_* constants don't match X keysyms, so these are spelled out.
+struct SpecialKey {
+    int godot_keycode;
+    KeySym keysym;
+};
+
+static const SpecialKey SPECIAL_KEYS[] = {
+    // Common special keys
+    {0x400001, XK_Escape},        // KEY_ESCAPE
+    {0x400002, XK_Tab},           // KEY_TAB
+    {0x400004, XK_BackSpace},     // KEY_BACKSPACE
+    {0x400005, XK_Return},        // KEY_ENTER
+    {0x400006, XK_KP_Enter},      // KEY_KP_ENTER
+
+    // Delete/Insert/Home/End/PageUp/PageDown
+    {0x400007, XK_Insert},        // KEY_INSERT
+    {0x400008, XK_Delete},        // KEY_DELETE
+    {0x400009, XK_Home},          // KEY_HOME
+    {0x40000A, XK_End},           // KEY_END
+    {0x40000B, XK_Page_Up},       // KEY_PAGEUP
+    {0x40000C, XK_Page_Down},     // KEY_PAGEDOWN
+
+    // Arrow keys
+    {0x40000F, XK_Left},          // KEY_LEFT
+    {0x400010, XK_Up},            // KEY_UP
+    {0x400011, XK_Right},         // KEY_RIGHT
+    {0x400012, XK_Down},          // KEY_DOWN
+
+    // Modifiers
+    {0x400015, XK_Shift_L},       // KEY_SHIFT
+    {0x400016, XK_Control_L},     // KEY_CTRL
+    {0x400017, XK_Meta_L},        // KEY_META
+    {0x400018, XK_Alt_L},         // KEY_ALT
+
+    // Function keys
+    {0x40001C, XK_F1},            // KEY_F1
+    {0x40001D, XK_F2},
+    {0x40001E, XK_F3},
+    {0x40001F, XK_F4},
+    {0x400020, XK_F5},
+    {0x400021, XK_F6},
+    {0x400022, XK_F7},
+    {0x400023, XK_F8},
+    {0x400024, XK_F9},
+    {0x400025, XK_F10},
+    {0x400026, XK_F11},
+    {0x400027, XK_F12},
+
+    // Keypad keys
+    {0x400081, XK_KP_Multiply},   // KEY_KP_MULTIPLY
+    {0x400082, XK_KP_Divide},     // KEY_KP_DIVIDE
+    {0x400083, XK_KP_Subtract},   // KEY_KP_SUBTRACT
+    {0x400084, XK_KP_Decimal},    // KEY_KP_PERIOD
+    {0x400085, XK_KP_Add},        // KEY_KP_ADD
+    {0x400086, XK_KP_0},          // KEY_KP_0
+    {0x400087, XK_KP_1},
+    {0x400088, XK_KP_2},
+    {0x400089, XK_KP_3},
+    {0x40008A, XK_KP_4},
+    {0x40008B, XK_KP_5},
+    {0x40008C, XK_KP_6},
+    {0x40008D, XK_KP_7},
+    {0x40008E, XK_KP_8},
+    {0x40008F, XK_KP_9},
+};
+
+KeyMap::KeyMap() : shift(0) {
+    memset(special, 0, sizeof(special));
+    memset(latin1, 0, sizeof(latin1));
+    memset(keycode_masks, 0, sizeof(keycode_masks));
+}
+
+bool KeyMap::build(Display *display) {
+    memset(special, 0, sizeof(special));
+    memset(latin1, 0, sizeof(latin1));
+    memset(keycode_masks, 0, sizeof(keycode_masks));
+    shift = 0;
+
+    // Keycode range comes with the connection setup; the mapping itself is a request
+    int min_keycode, max_keycode;
+    XDisplayKeycodes(display, &min_keycode, &max_keycode);
+    int keysyms_per_keycode = 0;
+    KeySym *keysyms = XGetKeyboardMapping(display, min_keycode, max_keycode - min_keycode + 1,
+                                          &keysyms_per_keycode);
+    if (!keysyms) {
+        return false;
+    }
+
+    // Keysym -> the key that produces it, preferring the unshifted level (column 0)
+    // over the shifted one (column 1). Levels past those need Mode_switch/AltGr.
+    FlatHashMap<unsigned long, Key> reverse;
+    int columns = keysyms_per_keycode < 2 ? keysyms_per_keycode : 2;
+    for (int column = 0; column < columns; column++) {
+        for (int keycode = min_keycode; keycode <= max_keycode; keycode++) {
+            KeySym keysym = keysyms[(keycode - min_keycode) * keysyms_per_keycode + column];
+            if (keysym == NoSymbol || reverse.find(keysym) != reverse.end()) {
+                continue;
+            }
+            reverse[keysym] = {(uint8_t)keycode, (uint8_t)(column ? ShiftMask : 0)};
+        }
+    }
+    XFree(keysyms);
+
+    auto find = [&reverse](KeySym keysym) {
+        auto it = reverse.find(keysym);
+        return it != reverse.end() ? it->second : Key{0, 0};
+    };
+
+    for (const SpecialKey &key : SPECIAL_KEYS) {
+        special[key.godot_keycode - SPECIAL_BASE] = find(key.keysym);
+    }
+
+    // Latin-1 keysyms are the code points themselves. Godot reports letters in
+    // upper case with Shift as a separate key, so look up the lower-case keysym.
+    for (int code = 0x20; code < LATIN1_COUNT; code++) {
+        KeySym lower, upper;
+        XConvertCase(code, &lower, &upper);
+        latin1[code] = find(lower);
+    }
+
+    // Which modifier each keycode drives, for tracking the state XSendEvent needs
+    XModifierKeymap *modifiers = XGetModifierMapping(display);
+    if (modifiers) {
+        for (int index = 0; index < 8; index++) {
+            for (int i = 0; i < modifiers->max_keypermod; i++) {
+                KeyCode keycode = modifiers->modifiermap[index * modifiers->max_keypermod + i];
+                if (keycode) {
+                    keycode_masks[keycode] |= 1 << index;
+                }
+            }
+        }
+        XFreeModifiermap(modifiers);
+    }
+    shift = find(XK_Shift_L).keycode;
+    return true;
+}
+
+bool KeyMap::lookup(int godot_keycode, KeyCode *keycode, unsigned int *modifiers) const {
+    const Key *key = nullptr;
+    if (godot_keycode >= SPECIAL_BASE && godot_keycode < SPECIAL_BASE + SPECIAL_COUNT) {
+        key = &special[godot_keycode - SPECIAL_BASE];
+    } else if (godot_keycode >= 0 && godot_keycode < LATIN1_COUNT) {
+        key = &latin1[godot_keycode];
+    }
+    if (!key || !key->keycode) {
+        return false;
+    }
+    *keycode = key->keycode;
+    *modifiers = key->modifiers;
+    return true;
+}
+
+} // namespace godot
@@ -0,0 +1,51 @@
+#ifndef KEY_MAP_HPP
+#define KEY_MAP_HPP
+
+#include <X11/Xlib.h>
+
+#include <cstdint>
+
+namespace godot {
+
+// Godot keycode -> X keycode table, built from the server's keyboard mapping so a
+// key event is a plain array lookup instead of a switch plus XKeysymToKeycode.
+// Godot's special keys are KEY_SPECIAL (0x400000) plus a small index and everything
+// else is Unicode, so two direct tables cover what the shell sends: special keys
+// and Latin-1. Rebuild it whenever the server sends MappingNotify.
+class KeyMap {
+public:
+    KeyMap();
+
+    // Read the keyboard and modifier mappings (two round trips). Returns false if
+    // the server wouldn't hand over its keyboard mapping; every lookup fails then.
+    bool build(Display *display);
+
+    // X keycode for a Godot keycode, and the modifiers that must be held for it to
+    // produce that key (ShiftMask for symbols only on a shifted level). Letters map
+    // to their unshifted key, as Godot reports Shift separately.
+    bool lookup(int godot_keycode, KeyCode *keycode, unsigned int *modifiers) const;
+
+    // Modifier mask a keycode sets while it's held (0 for ordinary keys)
+    unsigned int modifier_mask(KeyCode keycode) const { return keycode_masks[keycode]; }
+
+    KeyCode shift_keycode() const { return shift; }
+
+private:
+    static const int SPECIAL_BASE = 0x400000;  // Godot KEY_SPECIAL
+    static const int SPECIAL_COUNT = 0x100;
+    static const int LATIN1_COUNT = 0x100;
+
+    struct Key {
+        uint8_t keycode;    // 0 = not on this keyboard
+        uint8_t modifiers;
+    };
+
+    Key special[SPECIAL_COUNT];
+    Key latin1[LATIN1_COUNT];
+    uint8_t keycode_masks[256];
+    KeyCode shift;
+};
+
+} // namespace godot
+
+#endif // KEY_MAP_HPP
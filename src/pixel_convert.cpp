@@ -0,0 +1,445 @@
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace godot {
+
+// Portable fallback - one 32-bit load/store per pixel instead of byte shuffling
+template <bool KEEP_ALPHA>
+static void convert_row_scalar(const uint8_t *src, uint8_t *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        uint32_t p;
+        memcpy(&p, src + x * 4, 4);
+
+        // Little-endian BGRA (0xAARRGGBB) -> RGBA (0xAABBGGRR)
+        uint32_t alpha = KEEP_ALPHA ? (p & 0xFF000000u) : 0xFF000000u;
+        uint32_t out = ((p >> 16) & 0xFFu) | (p & 0xFF00u) | ((p & 0xFFu) << 16) | alpha;
+        memcpy(dst + x * 4, &out, 4);
+    }
+}
+
+// Reciprocals for un-premultiplying: c * 255 / a == (c * unpremultiply_table[a] + 0x8000) >> 16
+struct UnpremultiplyTable {
+    uint32_t scale[256];
+
+    UnpremultiplyTable() {
+        scale[0] = 0;
+        for (int a = 1; a < 256; a++) {
+            scale[a] = (255u << 16) / a;
+        }
+    }
+};
+static const UnpremultiplyTable unpremultiply_table;
+
+static inline uint32_t unpremultiply_pixel(uint32_t p) {
+    // Little-endian premultiplied BGRA (0xAARRGGBB) -> straight RGBA (0xAABBGGRR)
+    uint32_t a = p >> 24;
+    if (a == 255) {
+        return ((p >> 16) & 0xFFu) | (p & 0xFF00u) | ((p & 0xFFu) << 16) | 0xFF000000u;
+    }
+
+    uint32_t scale = unpremultiply_table.scale[a];
+    uint32_t r = std::min(255u, (((p >> 16) & 0xFFu) * scale + 0x8000u) >> 16);
+    uint32_t g = std::min(255u, (((p >> 8) & 0xFFu) * scale + 0x8000u) >> 16);
+    uint32_t b = std::min(255u, ((p & 0xFFu) * scale + 0x8000u) >> 16);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static void convert_row_premultiplied_scalar(const uint8_t *src, uint8_t *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        uint32_t p;
+        memcpy(&p, src + x * 4, 4);
+        uint32_t out = unpremultiply_pixel(p);
+        memcpy(dst + x * 4, &out, 4);
+    }
+}
+
+static void convert_row_bgr24_scalar(const uint8_t *src, uint8_t *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x * 4 + 0] = src[x * 3 + 2];
+        dst[x * 4 + 1] = src[x * 3 + 1];
+        dst[x * 4 + 2] = src[x * 3 + 0];
+        dst[x * 4 + 3] = 255;
+    }
+}
+
+static void convert_row_rgb565_scalar(const uint8_t *src, uint8_t *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        uint16_t p;
+        memcpy(&p, src + x * 2, 2);
+
+        // Widen each channel by replicating its top bits into the new low bits
+        uint32_t r = (p >> 11) & 0x1F;
+        uint32_t g = (p >> 5) & 0x3F;
+        uint32_t b = p & 0x1F;
+        uint32_t out = ((r << 3) | (r >> 2)) | (((g << 2) | (g >> 4)) << 8) |
+                       (((b << 3) | (b >> 2)) << 16) | 0xFF000000u;
+        memcpy(dst + x * 4, &out, 4);
+    }
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+// Swap bytes 0 and 2 of every pixel (B <-> R)
+#define PIXEL_SHUFFLE_MASK 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+
+template <bool KEEP_ALPHA>
+__attribute__((target("ssse3")))
+static void convert_row_ssse3(const uint8_t *src, uint8_t *dst, int width) {
+    const __m128i shuffle = _mm_setr_epi8(PIXEL_SHUFFLE_MASK);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        p = _mm_shuffle_epi8(p, shuffle);
+        if (!KEEP_ALPHA) {
+            p = _mm_or_si128(p, alpha);
+        }
+        _mm_storeu_si128((__m128i*)(dst + x * 4), p);
+    }
+    convert_row_scalar<KEEP_ALPHA>(src + x * 4, dst + x * 4, width - x);
+}
+
+template <bool KEEP_ALPHA>
+__attribute__((target("avx2")))
+static void convert_row_avx2(const uint8_t *src, uint8_t *dst, int width) {
+    // vpshufb works per 128-bit lane, so the mask is just repeated
+    const __m256i shuffle = _mm256_setr_epi8(PIXEL_SHUFFLE_MASK, PIXEL_SHUFFLE_MASK);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i p0 = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+        __m256i p1 = _mm256_loadu_si256((const __m256i*)(src + x * 4 + 32));
+        p0 = _mm256_shuffle_epi8(p0, shuffle);
+        p1 = _mm256_shuffle_epi8(p1, shuffle);
+        if (!KEEP_ALPHA) {
+            p0 = _mm256_or_si256(p0, alpha);
+            p1 = _mm256_or_si256(p1, alpha);
+        }
+        _mm256_storeu_si256((__m256i*)(dst + x * 4), p0);
+        _mm256_storeu_si256((__m256i*)(dst + x * 4 + 32), p1);
+    }
+    convert_row_ssse3<KEEP_ALPHA>(src + x * 4, dst + x * 4, width - x);
+}
+
+// ARGB windows are mostly fully opaque or fully transparent; only blocks with
+// partial alpha pay for the divide
+__attribute__((target("ssse3")))
+static void convert_row_premultiplied_ssse3(const uint8_t *src, uint8_t *dst, int width) {
+    const __m128i shuffle = _mm_setr_epi8(PIXEL_SHUFFLE_MASK);
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000u);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        __m128i alpha = _mm_and_si128(p, alpha_mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi8(p, shuffle));
+        } else if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_setzero_si128())) == 0xFFFF) {
+            // Premultiplied color under zero alpha is zero anyway
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi8(p, shuffle));
+        } else {
+            convert_row_premultiplied_scalar(src + x * 4, dst + x * 4, 4);
+        }
+    }
+    convert_row_premultiplied_scalar(src + x * 4, dst + x * 4, width - x);
+}
+
+__attribute__((target("ssse3")))
+static void convert_row_bgr24_ssse3(const uint8_t *src, uint8_t *dst, int width) {
+    // Four packed BGR pixels (12 bytes) -> four RGBA pixels
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+
+    int x = 0;
+    // Each load reads 16 bytes but only uses 12, so stop while 16 are still in bounds
+    for (; x + 6 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + x * 3));
+        p = _mm_or_si128(_mm_shuffle_epi8(p, shuffle), alpha);
+        _mm_storeu_si128((__m128i*)(dst + x * 4), p);
+    }
+    convert_row_bgr24_scalar(src + x * 3, dst + x * 4, width - x);
+}
+
+#undef PIXEL_SHUFFLE_MASK
+
+#endif // PIXEL_CONVERT_X86
+
+// Adds a row of bytes into 32-bit sums, one per byte (the vertical pass of the box filter)
+typedef void (*PixelRowAccumulator)(const uint8_t *src, uint32_t *sums, size_t bytes);
+
+static void accumulate_row_scalar(const uint8_t *src, uint32_t *sums, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        sums[i] += src[i];
+    }
+}
+
+#ifdef PIXEL_CONVERT_X86
+__attribute__((target("ssse3")))
+static void accumulate_row_ssse3(const uint8_t *src, uint32_t *sums, size_t bytes) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        // Widen 16 bytes to four vectors of 32-bit lanes
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i *s = (__m128i*)(sums + i);
+        _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+    accumulate_row_scalar(src + i, sums + i, bytes - i);
+}
+
+__attribute__((target("avx2")))
+static void accumulate_row_avx2(const uint8_t *src, uint32_t *sums, size_t bytes) {
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        __m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        __m256i *s = (__m256i*)(sums + i);
+        _mm256_storeu_si256(s, _mm256_add_epi32(_mm256_loadu_si256(s), wide));
+    }
+    accumulate_row_scalar(src + i, sums + i, bytes - i);
+}
+#endif
+
+// A full set of row converters, indexed by PixelFormat, plus the downscale kernel
+struct PixelKernelSet {
+    const char *name;
+    PixelRowConverter rows[PIXEL_FORMAT_COUNT];
+    PixelRowAccumulator accumulate;
+};
+
+static const PixelKernelSet scalar_kernels = {
+    "scalar", { convert_row_scalar<false>, convert_row_scalar<true>, convert_row_premultiplied_scalar,
+                convert_row_bgr24_scalar, convert_row_rgb565_scalar },
+    accumulate_row_scalar
+};
+#ifdef PIXEL_CONVERT_X86
+static const PixelKernelSet ssse3_kernels = {
+    "ssse3", { convert_row_ssse3<false>, convert_row_ssse3<true>, convert_row_premultiplied_ssse3,
+               convert_row_bgr24_ssse3, convert_row_rgb565_scalar },
+    accumulate_row_ssse3
+};
+static const PixelKernelSet avx2_kernels = {
+    "avx2", { convert_row_avx2<false>, convert_row_avx2<true>, convert_row_premultiplied_ssse3,
+              convert_row_bgr24_ssse3, convert_row_rgb565_scalar },
+    accumulate_row_avx2
+};
+#endif
+
+static const PixelKernelSet *active_kernels = &scalar_kernels;
+
+// CRC32C (Castagnoli polynomial, reflected), the same checksum SSE4.2 computes
+struct Crc32cTable {
+    uint32_t entries[256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0);
+            }
+            entries[i] = crc;
+        }
+    }
+};
+static const Crc32cTable crc32c_table;
+
+typedef uint32_t (*PixelRowHasher)(uint32_t crc, const uint8_t *src, size_t size);
+
+static uint32_t crc32c_row_scalar(uint32_t crc, const uint8_t *src, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        crc = crc32c_table.entries[(crc ^ src[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef PIXEL_CONVERT_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_row_sse42(uint32_t crc, const uint8_t *src, size_t size) {
+    size_t i = 0;
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, src + i, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for (; i + 4 <= size; i += 4) {
+        uint32_t word;
+        memcpy(&word, src + i, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; i < size; i++) {
+        crc = _mm_crc32_u8(crc, src[i]);
+    }
+    return crc;
+}
+#endif
+
+static PixelRowHasher active_row_hasher = crc32c_row_scalar;
+
+// All kernel sets this CPU can run, slowest first
+static std::vector<const PixelKernelSet*> supported_kernel_sets() {
+    std::vector<const PixelKernelSet*> sets;
+    sets.push_back(&scalar_kernels);
+#ifdef PIXEL_CONVERT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        sets.push_back(&ssse3_kernels);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        sets.push_back(&avx2_kernels);
+    }
+#endif
+    return sets;
+}
+
+void pixel_convert_init() {
+    active_kernels = supported_kernel_sets().back();
+
+#ifdef PIXEL_CONVERT_X86
+    if (__builtin_cpu_supports("sse4.2")) {
+        active_row_hasher = crc32c_row_sse42;
+    }
+#endif
+}
+
+const char *pixel_convert_kernel_name() {
+    return active_kernels->name;
+}
+
+int pixel_format_bytes(PixelFormat format) {
+    switch (format) {
+        case PIXEL_FORMAT_BGR24:
+            return 3;
+        case PIXEL_FORMAT_RGB565:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+const char *pixel_format_name(PixelFormat format) {
+    static const char *names[PIXEL_FORMAT_COUNT] = { "bgrx", "bgra", "bgra_premultiplied", "bgr24", "rgb565" };
+    return format < PIXEL_FORMAT_COUNT ? names[format] : "unknown";
+}
+
+void pixel_convert_rect(const uint8_t *src, size_t src_stride,
+                        uint8_t *dst, size_t dst_stride,
+                        int width, int height, PixelFormat format) {
+    PixelRowConverter convert_row = active_kernels->rows[format];
+
+    // Tightly packed rows can be converted as one long row
+    if (src_stride == (size_t)width * pixel_format_bytes(format) && dst_stride == (size_t)width * 4) {
+        convert_row(src, dst, width * height);
+        return;
+    }
+
+    for (int y = 0; y < height; y++) {
+        convert_row(src + y * src_stride, dst + y * dst_stride, width);
+    }
+}
+
+uint32_t pixel_hash_rect(const uint8_t *src, size_t stride, int width, int height) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (int y = 0; y < height; y++) {
+        crc = active_row_hasher(crc, src + y * stride, (size_t)width * 4);
+    }
+    return ~crc;
+}
+
+void pixel_downscale_box(const uint8_t *src, size_t src_stride, int src_width, int src_height,
+                         uint8_t *dst, size_t dst_stride, int dst_width, int dst_height) {
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        return;
+    }
+
+    // Source column span of every destination column (same for every row)
+    std::vector<int> column_start(dst_width + 1);
+    for (int x = 0; x <= dst_width; x++) {
+        column_start[x] = (int)((int64_t)x * src_width / dst_width);
+    }
+
+    // Per-byte sums of the source rows under the current destination row
+    PixelRowAccumulator accumulate = active_kernels->accumulate;
+    std::vector<uint32_t> column_sums((size_t)src_width * 4);
+
+    for (int y = 0; y < dst_height; y++) {
+        int y0 = (int)((int64_t)y * src_height / dst_height);
+        int y1 = (int)((int64_t)(y + 1) * src_height / dst_height);
+        std::fill(column_sums.begin(), column_sums.end(), 0);
+
+        // Vertical pass: whole source rows in order, so the reads stay sequential
+        // and the SIMD kernel works on long runs
+        for (int sy = y0; sy < y1; sy++) {
+            accumulate(src + sy * src_stride, column_sums.data(), (size_t)src_width * 4);
+        }
+
+        // Horizontal pass over the (much smaller) column sums
+        uint8_t *out = dst + y * dst_stride;
+        for (int x = 0; x < dst_width; x++) {
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int sx = column_start[x]; sx < column_start[x + 1]; sx++) {
+                const uint32_t *column = &column_sums[sx * 4];
+                sum[0] += column[0];
+                sum[1] += column[1];
+                sum[2] += column[2];
+                sum[3] += column[3];
+            }
+            uint32_t count = (uint32_t)(column_start[x + 1] - column_start[x]) * (uint32_t)(y1 - y0);
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = (uint8_t)((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+std::vector<PixelConvertBenchmark> pixel_convert_benchmark(int width, int height, int iterations) {
+    std::vector<PixelConvertBenchmark> results;
+    if (width <= 0 || height <= 0 || iterations <= 0) {
+        return results;
+    }
+
+    size_t stride = (size_t)width * 4;
+    std::vector<uint8_t> src(stride * height);
+    std::vector<uint8_t> dst(stride * height);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = (uint8_t)(i * 31);
+    }
+
+    for (const PixelKernelSet *set : supported_kernel_sets()) {
+        for (int format = 0; format < PIXEL_FORMAT_COUNT; format++) {
+            PixelRowConverter convert_row = set->rows[format];
+            size_t src_stride = (size_t)width * pixel_format_bytes((PixelFormat)format);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                for (int y = 0; y < height; y++) {
+                    convert_row(src.data() + y * src_stride, dst.data() + y * stride, width);
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double bytes = (double)src_stride * height * iterations;
+            results.push_back({ set->name, (PixelFormat)format, seconds > 0.0 ? bytes / seconds / 1e9 : 0.0 });
+        }
+    }
+    return results;
+}
+
+} // namespace godot
@@ -0,0 +1,62 @@
+#ifndef PIXEL_CONVERT_HPP
+#define PIXEL_CONVERT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace godot {
+
+// Source pixel layouts coming out of XImage (little-endian byte order)
+enum PixelFormat {
+    PIXEL_FORMAT_BGRX,                // 32bpp depth 24 - alpha byte is padding, output alpha is 255
+    PIXEL_FORMAT_BGRA,                // 32bpp with straight alpha - alpha byte is kept
+    PIXEL_FORMAT_BGRA_PREMULTIPLIED,  // 32bpp depth 32 (ARGB visuals) - un-premultiplied to straight alpha
+    PIXEL_FORMAT_BGR24,               // 24bpp packed, output alpha is 255
+    PIXEL_FORMAT_RGB565,              // 16bpp depth 16, output alpha is 255
+    PIXEL_FORMAT_COUNT,
+};
+
+// Bytes per source pixel
+int pixel_format_bytes(PixelFormat format);
+
+// Short name for logs and benchmark results ("bgrx", "rgb565", ...)
+const char *pixel_format_name(PixelFormat format);
+
+// Converts one row of `width` source pixels to RGBA8
+typedef void (*PixelRowConverter)(const uint8_t *src, uint8_t *dst, int width);
+
+// Pick the fastest kernels this CPU supports (SSSE3/AVX2 via cpuid, scalar otherwise).
+// Safe to call more than once.
+void pixel_convert_init();
+
+// Name of the kernel set selected by pixel_convert_init ("avx2", "ssse3" or "scalar")
+const char *pixel_convert_kernel_name();
+
+// Convert a width x height rectangle to RGBA8, honouring both strides (in bytes)
+void pixel_convert_rect(const uint8_t *src, size_t src_stride,
+                        uint8_t *dst, size_t dst_stride,
+                        int width, int height, PixelFormat format);
+
+// Box-filter an RGBA8 image down to dst_width x dst_height (each no larger than the
+// source). Every destination pixel is the average of the source pixels it covers.
+// The vertical pass uses the SSSE3/AVX2 kernel picked by pixel_convert_init.
+void pixel_downscale_box(const uint8_t *src, size_t src_stride, int src_width, int src_height,
+                         uint8_t *dst, size_t dst_stride, int dst_width, int dst_height);
+
+// CRC32C of a width x height RGBA8 rectangle (SSE4.2 crc32 instruction when available).
+// Used to tell whether a tile's contents actually changed since the last capture.
+uint32_t pixel_hash_rect(const uint8_t *src, size_t stride, int width, int height);
+
+// Microbenchmark: converts a width x height frame with every kernel available on this
+// CPU and reports throughput (source bytes read per second)
+struct PixelConvertBenchmark {
+    const char *kernel;
+    PixelFormat format;
+    double gigabytes_per_second;
+};
+std::vector<PixelConvertBenchmark> pixel_convert_benchmark(int width, int height, int iterations);
+
+} // namespace godot
+
+#endif // PIXEL_CONVERT_HPP
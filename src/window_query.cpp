@@ -0,0 +1,154 @@
+#include "window_query.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <xcb/xcbext.h>  // xcb_poll_for_reply
+
+namespace godot {
+
+// Longest WM_NAME / WM_CLASS we read, in 32-bit units
+static const uint32_t WINDOW_QUERY_STRING_LENGTH = 1024;
+
+static xcb_get_property_cookie_t get_property(xcb_connection_t *connection, xcb_window_t window,
+                                              xcb_atom_t property, xcb_atom_t type, uint32_t length) {
+    return xcb_get_property(connection, 0, window, property, type, 0, length);
+}
+
+WindowQuery window_query_send(xcb_connection_t *connection, xcb_window_t window, const X11Atoms &atoms) {
+    WindowQuery query;
+    query.attributes = xcb_get_window_attributes(connection, window);
+    query.geometry = xcb_get_geometry(connection, window);
+    query.wm_state = get_property(connection, window, atoms[ATOM_WM_STATE], XCB_GET_PROPERTY_TYPE_ANY, 0);
+    query.name = get_property(connection, window, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, WINDOW_QUERY_STRING_LENGTH);
+    query.wm_class = get_property(connection, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, WINDOW_QUERY_STRING_LENGTH);
+    query.pid = get_property(connection, window, atoms[ATOM_NET_WM_PID], XCB_ATOM_CARDINAL, 1);
+    query.transient_for = get_property(connection, window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 1);
+    query.types = get_property(connection, window, atoms[ATOM_NET_WM_WINDOW_TYPE], XCB_ATOM_ATOM, 32);
+    return query;
+}
+
+// Reply for a property request, or nullptr if it's missing or not of the expected
+// format (0 accepts any)
+static xcb_get_property_reply_t *property_reply(xcb_connection_t *connection, xcb_get_property_cookie_t cookie,
+                                                uint8_t format) {
+    xcb_generic_error_t *error = nullptr;
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(connection, cookie, &error);
+    free(error);
+    if (reply && (reply->type == XCB_NONE || (format && reply->format != format))) {
+        free(reply);
+        return nullptr;
+    }
+    return reply;
+}
+
+// WM_NAME as XFetchName returns it: Latin-1 STRING only
+static void assign_name(xcb_get_property_reply_t *reply, std::string *name) {
+    if (reply && reply->type == XCB_ATOM_STRING) {
+        name->assign((const char*)xcb_get_property_value(reply), xcb_get_property_value_length(reply));
+    }
+}
+
+bool window_query_receive(xcb_connection_t *connection, const WindowQuery &query, WindowInfo *info) {
+    xcb_generic_error_t *error = nullptr;
+    xcb_get_window_attributes_reply_t *attributes = xcb_get_window_attributes_reply(connection, query.attributes, &error);
+    free(error);
+    error = nullptr;
+    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(connection, query.geometry, &error);
+    free(error);
+
+    xcb_get_property_reply_t *wm_state = property_reply(connection, query.wm_state, 0);
+    xcb_get_property_reply_t *name = property_reply(connection, query.name, 8);
+    xcb_get_property_reply_t *wm_class = property_reply(connection, query.wm_class, 8);
+    xcb_get_property_reply_t *pid = property_reply(connection, query.pid, 32);
+    xcb_get_property_reply_t *transient_for = property_reply(connection, query.transient_for, 32);
+    xcb_get_property_reply_t *types = property_reply(connection, query.types, 32);
+
+    bool ok = attributes && geometry;
+    if (ok) {
+        *info = WindowInfo();
+        info->x = geometry->x;
+        info->y = geometry->y;
+        info->width = geometry->width;
+        info->height = geometry->height;
+        info->border = geometry->border_width;
+        info->depth = geometry->depth;
+        info->visual = attributes->visual;
+        info->input_only = attributes->_class == XCB_WINDOW_CLASS_INPUT_ONLY;
+        info->viewable = attributes->map_state == XCB_MAP_STATE_VIEWABLE;
+
+        // Zero-length read: only whether the property exists matters
+        info->managed = wm_state != nullptr;
+
+        assign_name(name, &info->name);
+
+        // WM_CLASS is "instance\0class\0"
+        if (wm_class) {
+            const char *value = (const char*)xcb_get_property_value(wm_class);
+            int length = xcb_get_property_value_length(wm_class);
+            size_t instance_length = strnlen(value, length);
+            if ((int)instance_length < length) {
+                const char *class_name = value + instance_length + 1;
+                info->wm_class.assign(class_name, strnlen(class_name, length - instance_length - 1));
+            }
+        }
+
+        if (pid && xcb_get_property_value_length(pid) >= 4) {
+            info->pid = *(const int32_t*)xcb_get_property_value(pid);
+        }
+        if (transient_for && xcb_get_property_value_length(transient_for) >= 4) {
+            info->transient_for = *(const xcb_window_t*)xcb_get_property_value(transient_for);
+        }
+        if (types) {
+            const xcb_atom_t *atoms = (const xcb_atom_t*)xcb_get_property_value(types);
+            info->types.assign(atoms, atoms + xcb_get_property_value_length(types) / 4);
+        }
+    }
+
+    free(attributes);
+    free(geometry);
+    free(wm_state);
+    free(name);
+    free(wm_class);
+    free(pid);
+    free(transient_for);
+    free(types);
+    return ok;
+}
+
+xcb_get_property_cookie_t window_name_send(xcb_connection_t *connection, xcb_window_t window) {
+    return get_property(connection, window, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, WINDOW_QUERY_STRING_LENGTH);
+}
+
+bool window_name_poll(xcb_connection_t *connection, xcb_get_property_cookie_t cookie, std::string *name) {
+    void *reply = nullptr;
+    xcb_generic_error_t *error = nullptr;
+    if (!xcb_poll_for_reply(connection, cookie.sequence, &reply, &error)) {
+        return false;
+    }
+    free(error);
+
+    xcb_get_property_reply_t *property = (xcb_get_property_reply_t*)reply;
+    name->clear();
+    if (property && property->format == 8) {
+        assign_name(property, name);
+    }
+    free(reply);
+    return true;
+}
+
+bool window_root_origin(xcb_connection_t *connection, xcb_window_t window, xcb_window_t root, int *x, int *y) {
+    xcb_generic_error_t *error = nullptr;
+    xcb_translate_coordinates_reply_t *reply =
+        xcb_translate_coordinates_reply(connection, xcb_translate_coordinates(connection, window, root, 0, 0), &error);
+    free(error);
+    if (!reply) {
+        return false;
+    }
+    *x = reply->dst_x;
+    *y = reply->dst_y;
+    free(reply);
+    return true;
+}
+
+} // namespace godot
@@ -0,0 +1,67 @@
+#ifndef WINDOW_QUERY_HPP
+#define WINDOW_QUERY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <xcb/xcb.h>
+
+#include "x11_atoms.hpp"
+
+namespace godot {
+
+// Everything the compositor needs to know about a window to decide whether to
+// track it and to set up its tracking state
+struct WindowInfo {
+    int x = 0, y = 0;                 // Relative to the parent
+    int width = 0, height = 0;
+    int border = 0;
+    int depth = 0;
+    xcb_visualid_t visual = 0;
+    bool input_only = false;
+    bool viewable = false;            // map_state == IsViewable
+    bool managed = false;             // Has WM_STATE
+    std::string name;                 // WM_NAME (Latin-1 STRING only, like XFetchName)
+    std::string wm_class;             // Second string of WM_CLASS
+    int pid = -1;                     // _NET_WM_PID
+    xcb_window_t transient_for = 0;   // WM_TRANSIENT_FOR
+    std::vector<xcb_atom_t> types;    // _NET_WM_WINDOW_TYPE
+};
+
+// Outstanding requests for one window. Send queries for any number of windows
+// first, then receive them: XCB pipelines the requests, so the whole batch costs
+// a single round trip instead of one per attribute and property.
+struct WindowQuery {
+    xcb_get_window_attributes_cookie_t attributes;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_get_property_cookie_t wm_state;
+    xcb_get_property_cookie_t name;
+    xcb_get_property_cookie_t wm_class;
+    xcb_get_property_cookie_t pid;
+    xcb_get_property_cookie_t transient_for;
+    xcb_get_property_cookie_t types;
+};
+
+WindowQuery window_query_send(xcb_connection_t *connection, xcb_window_t window, const X11Atoms &atoms);
+
+// Collect the replies. Returns false if the window is gone (every reply is still
+// consumed, so the query must be received exactly once either way).
+bool window_query_receive(xcb_connection_t *connection, const WindowQuery &query, WindowInfo *info);
+
+// WM_NAME on its own, for PropertyNotify. The reply is polled for on a later
+// frame instead of waited on, so a title change never costs _process a round trip.
+xcb_get_property_cookie_t window_name_send(xcb_connection_t *connection, xcb_window_t window);
+
+// Returns false while the reply is still in flight. Once it returns true the
+// cookie is used up and *name holds the title ("" if there is none, or the
+// window is gone).
+bool window_name_poll(xcb_connection_t *connection, xcb_get_property_cookie_t cookie, std::string *name);
+
+// Root position of the inside of `window` (a round trip, unlike the batch above).
+// Returns false if the window is gone.
+bool window_root_origin(xcb_connection_t *connection, xcb_window_t window, xcb_window_t root, int *x, int *y);
+
+} // namespace godot
+
+#endif // WINDOW_QUERY_HPP
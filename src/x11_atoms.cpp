@@ -0,0 +1,55 @@
+#include "x11_atoms.hpp"
+
+namespace godot {
+
+static const char *X11_ATOM_NAMES[] = {
+    "WM_STATE",
+    "WM_PROTOCOLS",
+    "WM_DELETE_WINDOW",
+    "WM_TAKE_FOCUS",
+    "UTF8_STRING",
+
+    "_NET_SUPPORTED",
+    "_NET_CLIENT_LIST",
+    "_NET_CLIENT_LIST_STACKING",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_CLOSE_WINDOW",
+    "_NET_MOVERESIZE_WINDOW",
+
+    "_NET_WM_NAME",
+    "_NET_WM_PID",
+    "_NET_WM_ICON",
+    "_NET_WM_WINDOW_OPACITY",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_NORMAL",
+    "_NET_WM_WINDOW_TYPE_DIALOG",
+    "_NET_WM_WINDOW_TYPE_UTILITY",
+    "_NET_WM_WINDOW_TYPE_MENU",
+    "_NET_WM_WINDOW_TYPE_POPUP_MENU",
+    "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU",
+    "_NET_WM_WINDOW_TYPE_TOOLTIP",
+    "_NET_WM_WINDOW_TYPE_NOTIFICATION",
+    "_NET_WM_WINDOW_TYPE_SPLASH",
+    "_NET_WM_WINDOW_TYPE_DOCK",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_MODAL",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_STATE_FULLSCREEN",
+    "_NET_WM_STATE_MAXIMIZED_VERT",
+    "_NET_WM_STATE_MAXIMIZED_HORZ",
+    "_NET_WM_STATE_ABOVE",
+};
+static_assert(sizeof(X11_ATOM_NAMES) / sizeof(X11_ATOM_NAMES[0]) == ATOM_COUNT,
+              "X11_ATOM_NAMES must list every X11AtomId");
+
+X11Atoms::X11Atoms() {
+    for (int i = 0; i < ATOM_COUNT; i++) {
+        atoms[i] = None;
+    }
+}
+
+bool X11Atoms::intern(Display *display) {
+    return XInternAtoms(display, (char**)X11_ATOM_NAMES, ATOM_COUNT, False, atoms) != 0;
+}
+
+} // namespace godot
@@ -0,0 +1,71 @@
+#ifndef X11_ATOMS_HPP
+#define X11_ATOMS_HPP
+
+#include <X11/Xlib.h>
+
+namespace godot {
+
+// Every atom the compositor uses that isn't predefined (XA_*). Interned once at
+// connect time; keep X11_ATOM_NAMES in x11_atoms.cpp in the same order.
+enum X11AtomId {
+    // ICCCM
+    ATOM_WM_STATE,
+    ATOM_WM_PROTOCOLS,
+    ATOM_WM_DELETE_WINDOW,
+    ATOM_WM_TAKE_FOCUS,
+    ATOM_UTF8_STRING,
+
+    // EWMH root window properties and messages
+    ATOM_NET_SUPPORTED,
+    ATOM_NET_CLIENT_LIST,
+    ATOM_NET_CLIENT_LIST_STACKING,
+    ATOM_NET_ACTIVE_WINDOW,
+    ATOM_NET_CLOSE_WINDOW,
+    ATOM_NET_MOVERESIZE_WINDOW,
+
+    // EWMH window properties
+    ATOM_NET_WM_NAME,
+    ATOM_NET_WM_PID,
+    ATOM_NET_WM_ICON,
+    ATOM_NET_WM_WINDOW_OPACITY,
+    ATOM_NET_WM_WINDOW_TYPE,
+    ATOM_NET_WM_WINDOW_TYPE_NORMAL,
+    ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+    ATOM_NET_WM_WINDOW_TYPE_UTILITY,
+    ATOM_NET_WM_WINDOW_TYPE_MENU,
+    ATOM_NET_WM_WINDOW_TYPE_POPUP_MENU,
+    ATOM_NET_WM_WINDOW_TYPE_DROPDOWN_MENU,
+    ATOM_NET_WM_WINDOW_TYPE_TOOLTIP,
+    ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION,
+    ATOM_NET_WM_WINDOW_TYPE_SPLASH,
+    ATOM_NET_WM_WINDOW_TYPE_DOCK,
+    ATOM_NET_WM_STATE,
+    ATOM_NET_WM_STATE_MODAL,
+    ATOM_NET_WM_STATE_HIDDEN,
+    ATOM_NET_WM_STATE_FULLSCREEN,
+    ATOM_NET_WM_STATE_MAXIMIZED_VERT,
+    ATOM_NET_WM_STATE_MAXIMIZED_HORZ,
+    ATOM_NET_WM_STATE_ABOVE,
+
+    ATOM_COUNT,
+};
+
+// Interned atom table. XInternAtoms sends every request before waiting for a
+// reply, so filling the table costs one round trip; lookups after that are free.
+class X11Atoms {
+public:
+    X11Atoms();
+
+    // Intern the whole table on `display`. Returns false if any atom couldn't be
+    // interned (those entries stay None).
+    bool intern(Display *display);
+
+    Atom operator[](X11AtomId id) const { return atoms[id]; }
+
+private:
+    Atom atoms[ATOM_COUNT];
+};
+
+} // namespace godot
+
+#endif // X11_ATOMS_HPP
@@ -1,12 +1,17 @@
 #include "x11_compositor.hpp"
+#include "pixel_convert.hpp"
+#include "frame_codec.hpp"
 
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 #include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
+#include <godot_cpp/classes/rd_texture_format.hpp>
+#include <godot_cpp/classes/rd_texture_view.hpp>
 
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
-#include <X11/keysymdef.h>
+#include <cmath>
 #include <cstring>
 #include <cstdio>
 #include <algorithm>
@@ -15,11 +20,41 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <chrono>
 
 using namespace godot;
 
+// Error handler installed while the capture thread runs. Errors on the capture
+// connection are counted and ignored (windows can vanish mid-capture, and XShmAttach
+// reports failure asynchronously); everything else goes to the previous handler.
+static Display *capture_error_display = nullptr;
+static std::atomic<int> capture_error_count(0);
+static XErrorHandler previous_error_handler = nullptr;
+static int handle_capture_errors(Display *display, XErrorEvent *error) {
+    if (display == capture_error_display) {
+        capture_error_count++;
+        return 0;
+    }
+    return previous_error_handler ? previous_error_handler(display, error) : 0;
+}
+
+// Frame memory budget: windows not displayed for COLD_FRAME_AGE frames may be
+// parked, and the main thread looks for parked windows to release every
+// COLD_RELEASE_INTERVAL_FRAMES frames
+static const uint64_t COLD_FRAME_AGE = 120;
+static const uint64_t COLD_RELEASE_INTERVAL_FRAMES = 60;
+
+static int64_t steady_usec() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 X11Compositor::X11Compositor() :
     display(nullptr),
+    xcb_connection(nullptr),
+    key_modifier_state(0),
     root_window(0),
     screen(0),
     display_number(0),
@@ -27,6 +62,45 @@ X11Compositor::X11Compositor() :
     composite_available(false),
     damage_available(false),
     xtest_available(false),
+    shm_available(false),
+    shm_rejected(false),
+    xfixes_available(false),
+    render_available(false),
+    framebuffer_capture(false),
+    stacking_dirty(false),
+    framebuffer_recheck_pending(false),
+    framebuffer_captures(0),
+    capture_display(nullptr),
+    damage_parts(None),
+    capture_running(false),
+    capture_requested(false),
+    capture_wanted(false),
+    frame_counter(0),
+    capture_budget_usec(4000),
+    focused_xwindow(0),
+    capture_backlog(0),
+    pixmap_recreations(0),
+    shm_segment_reuses(0),
+    unchanged_tiles(0),
+    unchanged_captures(0),
+    last_capture_pass_usec(0),
+    capture_pass(0),
+    frame_memory_budget(512LL * 1024 * 1024),
+    texture_full_uploads(0),
+    texture_tile_uploads(0),
+    texture_upload_bytes(0),
+    thumbnail_max_size(256),
+    thumbnail_interval_usec(250000),
+    window_generation(1),
+    window_snapshot_generation(0),
+    verify_window_positions(false),
+    position_mismatches(0),
+    input_queued_usec(0),
+    input_latency_usec(0),
+    input_events_received(0),
+    input_events_sent(0),
+    input_motion_coalesced(0),
+    input_flushes(0),
     next_window_id(1),
     initialized(false) {
 }
@@ -37,8 +111,18 @@ X11Compositor::~X11Compositor() {
 
 void X11Compositor::_bind_methods() {
     ClassDB::bind_method(D_METHOD("initialize"), &X11Compositor::initialize);
+    ClassDB::bind_method(D_METHOD("set_framebuffer_capture_enabled", "enabled"), &X11Compositor::set_framebuffer_capture_enabled);
+    ClassDB::bind_method(D_METHOD("is_framebuffer_capture_enabled"), &X11Compositor::is_framebuffer_capture_enabled);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "framebuffer_capture_enabled"), "set_framebuffer_capture_enabled", "is_framebuffer_capture_enabled");
     ClassDB::bind_method(D_METHOD("get_window_ids"), &X11Compositor::get_window_ids);
+    ClassDB::bind_method(D_METHOD("get_window_generation"), &X11Compositor::get_window_generation);
+    ClassDB::bind_method(D_METHOD("get_window_snapshot"), &X11Compositor::get_window_snapshot);
+    BIND_ENUM_CONSTANT(WINDOW_SNAPSHOT_MAPPED);
+    BIND_ENUM_CONSTANT(WINDOW_SNAPSHOT_DIALOG);
+    BIND_ENUM_CONSTANT(WINDOW_SNAPSHOT_TRANSPARENT);
     ClassDB::bind_method(D_METHOD("get_window_buffer", "window_id"), &X11Compositor::get_window_buffer);
+    ClassDB::bind_method(D_METHOD("get_window_texture", "window_id"), &X11Compositor::get_window_texture);
+    ClassDB::bind_method(D_METHOD("get_window_thumbnail", "window_id"), &X11Compositor::get_window_thumbnail);
     ClassDB::bind_method(D_METHOD("get_window_size", "window_id"), &X11Compositor::get_window_size);
     ClassDB::bind_method(D_METHOD("get_display_name"), &X11Compositor::get_display_name);
     ClassDB::bind_method(D_METHOD("is_initialized"), &X11Compositor::is_initialized);
@@ -51,6 +135,9 @@ void X11Compositor::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_window_position", "window_id"), &X11Compositor::get_window_position);
     ClassDB::bind_method(D_METHOD("is_window_mapped", "window_id"), &X11Compositor::is_window_mapped);
     ClassDB::bind_method(D_METHOD("is_window_dialog", "window_id"), &X11Compositor::is_window_dialog);
+    ClassDB::bind_method(D_METHOD("is_window_transparent", "window_id"), &X11Compositor::is_window_transparent);
+    ClassDB::bind_method(D_METHOD("get_window_capture_backend", "window_id"), &X11Compositor::get_window_capture_backend);
+    ClassDB::bind_method(D_METHOD("get_window_dirty_rects", "window_id"), &X11Compositor::get_window_dirty_rects);
 
     // Input handling
     ClassDB::bind_method(D_METHOD("send_mouse_button", "window_id", "button", "pressed", "x", "y"), &X11Compositor::send_mouse_button);
@@ -58,9 +145,54 @@ void X11Compositor::_bind_methods() {
     ClassDB::bind_method(D_METHOD("send_key_event", "window_id", "keycode", "pressed"), &X11Compositor::send_key_event);
     ClassDB::bind_method(D_METHOD("set_window_focus", "window_id"), &X11Compositor::set_window_focus);
     ClassDB::bind_method(D_METHOD("release_all_keys"), &X11Compositor::release_all_keys);
+    ClassDB::bind_method(D_METHOD("set_verify_window_positions", "enabled"), &X11Compositor::set_verify_window_positions);
+    ClassDB::bind_method(D_METHOD("is_verify_window_positions_enabled"), &X11Compositor::is_verify_window_positions_enabled);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "verify_window_positions"), "set_verify_window_positions", "is_verify_window_positions_enabled");
+    ClassDB::bind_method(D_METHOD("set_input_latency_ms", "latency_ms"), &X11Compositor::set_input_latency_ms);
+    ClassDB::bind_method(D_METHOD("get_input_latency_ms"), &X11Compositor::get_input_latency_ms);
+    ClassDB::bind_method(D_METHOD("get_input_stats"), &X11Compositor::get_input_stats);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "input_latency_ms"), "set_input_latency_ms", "get_input_latency_ms");
 
     // Window manipulation
     ClassDB::bind_method(D_METHOD("resize_window", "window_id", "width", "height"), &X11Compositor::resize_window);
+
+    // Capture interest
+    ClassDB::bind_method(D_METHOD("set_window_interest", "window_id", "interest"), &X11Compositor::set_window_interest);
+    ClassDB::bind_method(D_METHOD("get_window_interest", "window_id"), &X11Compositor::get_window_interest);
+    ClassDB::bind_method(D_METHOD("set_window_lod", "window_id", "max_pixels", "max_fps"), &X11Compositor::set_window_lod);
+    BIND_ENUM_CONSTANT(WINDOW_INTEREST_VISIBLE);
+    BIND_ENUM_CONSTANT(WINDOW_INTEREST_THUMBNAIL);
+    BIND_ENUM_CONSTANT(WINDOW_INTEREST_HIDDEN);
+
+    // Thumbnail channel
+    ClassDB::bind_method(D_METHOD("set_thumbnail_max_size", "max_size"), &X11Compositor::set_thumbnail_max_size);
+    ClassDB::bind_method(D_METHOD("get_thumbnail_max_size"), &X11Compositor::get_thumbnail_max_size);
+    ClassDB::bind_method(D_METHOD("set_thumbnail_fps", "fps"), &X11Compositor::set_thumbnail_fps);
+    ClassDB::bind_method(D_METHOD("get_thumbnail_fps"), &X11Compositor::get_thumbnail_fps);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "thumbnail_max_size"), "set_thumbnail_max_size", "get_thumbnail_max_size");
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "thumbnail_fps"), "set_thumbnail_fps", "get_thumbnail_fps");
+
+    // Capture scheduling
+    ClassDB::bind_method(D_METHOD("set_capture_budget_ms", "budget_ms"), &X11Compositor::set_capture_budget_ms);
+    ClassDB::bind_method(D_METHOD("get_capture_budget_ms"), &X11Compositor::get_capture_budget_ms);
+    ClassDB::bind_method(D_METHOD("get_capture_stats"), &X11Compositor::get_capture_stats);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "capture_budget_ms"), "set_capture_budget_ms", "get_capture_budget_ms");
+
+    // Frame memory budget
+    ClassDB::bind_method(D_METHOD("set_frame_memory_budget_mb", "budget_mb"), &X11Compositor::set_frame_memory_budget_mb);
+    ClassDB::bind_method(D_METHOD("get_frame_memory_budget_mb"), &X11Compositor::get_frame_memory_budget_mb);
+    ClassDB::bind_method(D_METHOD("get_memory_stats"), &X11Compositor::get_memory_stats);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "frame_memory_budget_mb"), "set_frame_memory_budget_mb", "get_frame_memory_budget_mb");
+
+    // Window lifecycle signals (emitted from the X event handlers, so scripts don't need to poll)
+    ADD_SIGNAL(MethodInfo("window_created", PropertyInfo(Variant::INT, "window_id")));
+    ADD_SIGNAL(MethodInfo("window_destroyed", PropertyInfo(Variant::INT, "window_id")));
+    ADD_SIGNAL(MethodInfo("window_mapped", PropertyInfo(Variant::INT, "window_id")));
+    ADD_SIGNAL(MethodInfo("window_unmapped", PropertyInfo(Variant::INT, "window_id")));
+    ADD_SIGNAL(MethodInfo("window_resized", PropertyInfo(Variant::INT, "window_id"), PropertyInfo(Variant::VECTOR2I, "size")));
+    ADD_SIGNAL(MethodInfo("window_moved", PropertyInfo(Variant::INT, "window_id"), PropertyInfo(Variant::VECTOR2I, "position")));
+    ADD_SIGNAL(MethodInfo("window_damaged", PropertyInfo(Variant::INT, "window_id"), PropertyInfo(Variant::RECT2I, "rect")));
+    ADD_SIGNAL(MethodInfo("title_changed", PropertyInfo(Variant::INT, "window_id"), PropertyInfo(Variant::STRING, "title")));
 }
 
 void X11Compositor::_ready() {
@@ -83,11 +215,20 @@ void X11Compositor::_process(double delta) {
         return;
     }
 
+    // Send the pointer motion scripts queued since the last flush
+    if (!input_queue.empty() && steady_usec() - input_queued_usec >= input_latency_usec) {
+        flush_input();
+    }
+
     // Process X11 events (non-blocking)
     while (XPending(display) > 0) {
         XEvent event;
         XNextEvent(display, &event);
 
+        if (framebuffer.is_open()) {
+            track_stacking(&event);
+        }
+
         switch (event.type) {
             case CreateNotify:
                 handle_create_notify(&event.xcreatewindow);
@@ -104,6 +245,19 @@ void X11Compositor::_process(double delta) {
             case ConfigureNotify:
                 handle_configure_notify(&event.xconfigure);
                 break;
+            case ReparentNotify:
+                handle_reparent_notify(&event.xreparent);
+                break;
+            case PropertyNotify:
+                handle_property_notify(&event.xproperty);
+                break;
+            case MappingNotify:
+                // Sent to every client whether it asked or not
+                XRefreshKeyboardMapping(&event.xmapping);
+                if (event.xmapping.request == MappingKeyboard || event.xmapping.request == MappingModifier) {
+                    key_map.build(display);
+                }
+                break;
             default:
                 // Check for Damage events
                 if (damage_available && event.type == damage_event_base + XDamageNotify) {
@@ -113,13 +267,28 @@ void X11Compositor::_process(double delta) {
         }
     }
 
-    // Periodically capture window contents for all mapped windows
-    // (in a real implementation, we'd only do this on damage events)
-    for (auto &pair : windows) {
-        X11Window *window = pair.second;
-        if (window->mapped) {
-            capture_window_contents(window);
-        }
+    // Titles asked for by PropertyNotify, this frame or earlier
+    if (!pending_titles.empty()) {
+        receive_titles();
+    }
+
+    // Let go of the main thread's copy of frames the capture thread has parked
+    if (frame_counter % COLD_RELEASE_INTERVAL_FRAMES == 0) {
+        release_cold_frames();
+    }
+
+    // Tell the capture thread which windows it can read straight off the screen
+    if (stacking_dirty) {
+        update_framebuffer_placement();
+    }
+
+    // Window capture happens on the capture thread; finished frames are
+    // picked up lazily by get_window_buffer. Wake it once per frame however many
+    // damage events arrived, and keep waking it while it has deferred work.
+    frame_counter++;
+    if (capture_wanted || capture_backlog > 0) {
+        capture_wanted = false;
+        request_capture();
     }
 }
 
@@ -159,6 +328,16 @@ int X11Compositor::find_available_display() {
 bool X11Compositor::launch_xephyr(int disp_num) {
     UtilityFunctions::print("Launching Xvfb (headless X server) on display :", disp_num, " with screen size 2560x1440");
 
+    // Xvfb writes its screen to DIR/Xvfb_screen0 when given -fbdir
+    if (framebuffer_capture) {
+        char dir_template[] = "/tmp/drizzle-fb-XXXXXX";
+        if (mkdtemp(dir_template)) {
+            framebuffer_dir = dir_template;
+        } else {
+            UtilityFunctions::printerr("Failed to create framebuffer directory, framebuffer capture disabled");
+        }
+    }
+
     pid_t pid = fork();
 
     if (pid < 0) {
@@ -178,12 +357,23 @@ bool X11Compositor::launch_xephyr(int disp_num) {
         // -ac = disable access control (allow all connections)
         // -screen 0 WxHxD = set screen 0 size and depth
         // +extension COMPOSITE = enable Composite extension explicitly
-        execlp("Xvfb", "Xvfb",
-               display_arg,
-               "-ac",
-               "-screen", "0", screen_arg,
-               "+extension", "Composite",
-               nullptr);
+        // -fbdir DIR = export the screen as a memory-mapped file (framebuffer capture)
+        if (!framebuffer_dir.empty()) {
+            execlp("Xvfb", "Xvfb",
+                   display_arg,
+                   "-ac",
+                   "-screen", "0", screen_arg,
+                   "+extension", "Composite",
+                   "-fbdir", framebuffer_dir.c_str(),
+                   nullptr);
+        } else {
+            execlp("Xvfb", "Xvfb",
+                   display_arg,
+                   "-ac",
+                   "-screen", "0", screen_arg,
+                   "+extension", "Composite",
+                   nullptr);
+        }
 
         // If execlp returns, it failed
         _exit(1);
@@ -238,6 +428,15 @@ bool X11Compositor::initialize() {
 
     UtilityFunctions::print("Initializing X11Compositor...");
 
+    // The capture thread uses Xlib concurrently with the main thread (on its own
+    // connection), so Xlib's global state needs locking. This must happen before
+    // we open any displays; it's a no-op on libX11 >= 1.8 where it's automatic.
+    XInitThreads();
+
+    // Select SIMD pixel conversion kernels for this CPU
+    pixel_convert_init();
+    UtilityFunctions::print("Pixel conversion kernels: ", pixel_convert_kernel_name());
+
     // Find an available display number
     display_number = find_available_display();
     if (display_number < 0) {
@@ -250,6 +449,7 @@ bool X11Compositor::initialize() {
     // Launch Xvfb on that display
     if (!launch_xephyr(display_number)) {
         UtilityFunctions::printerr("Failed to launch Xvfb");
+        cleanup();  // The framebuffer directory may already exist
         return false;
     }
 
@@ -266,8 +466,31 @@ bool X11Compositor::initialize() {
     screen = DefaultScreen(display);
     root_window = RootWindow(display, screen);
 
+    // Window discovery pipelines its requests over the XCB side of the connection
+    xcb_connection = XGetXCBConnection(display);
+
+    // Intern every atom we'll need in one round trip, so property code never waits on one
+    if (!atoms.intern(display)) {
+        UtilityFunctions::printerr("Failed to intern X11 atoms");
+    }
+
+    // Same for the keyboard: key events look their keycode up in this table
+    if (!key_map.build(display)) {
+        UtilityFunctions::printerr("Failed to read the X keyboard mapping");
+    }
+
     UtilityFunctions::print("Connected to Xvfb display: ", DisplayString(display));
 
+    // Map the Xvfb screen for the framebuffer capture backend
+    if (!framebuffer_dir.empty()) {
+        if (framebuffer.open(framebuffer_dir + "/Xvfb_screen0")) {
+            UtilityFunctions::print("Framebuffer capture enabled: ", framebuffer.get_width(), "x", framebuffer.get_height(),
+                                    " (unobscured windows are read straight off the screen)");
+        } else {
+            UtilityFunctions::printerr("Could not map the Xvfb framebuffer, using pixmap capture only");
+        }
+    }
+
     // Check for Composite extension
     int composite_major, composite_minor;
     if (XCompositeQueryExtension(display, &composite_event_base, &composite_error_base)) {
@@ -295,6 +518,28 @@ bool X11Compositor::initialize() {
         damage_available = false;
     }
 
+    // Check for XFixes extension (lets us fetch damage regions for partial capture)
+    int xfixes_event_base, xfixes_error_base;
+    if (XFixesQueryExtension(display, &xfixes_event_base, &xfixes_error_base)) {
+        int xfixes_major = 0, xfixes_minor = 0;
+        XFixesQueryVersion(display, &xfixes_major, &xfixes_minor);
+        UtilityFunctions::print("XFixes extension available: ", xfixes_major, ".", xfixes_minor);
+        xfixes_available = true;
+    } else {
+        UtilityFunctions::print("XFixes extension not available (damaged windows will be fully recaptured)");
+        xfixes_available = false;
+    }
+
+    // Check for XRender extension (lets distant windows be downscaled before transfer)
+    int render_event_base, render_error_base;
+    if (XRenderQueryExtension(display, &render_event_base, &render_error_base)) {
+        UtilityFunctions::print("XRender extension available");
+        render_available = true;
+    } else {
+        UtilityFunctions::print("XRender extension not available (window LOD will only limit frame rate)");
+        render_available = false;
+    }
+
     // Check for XTest extension (for realistic input events)
     int xtest_event_base, xtest_error_base;
     int xtest_major, xtest_minor;
@@ -307,6 +552,55 @@ bool X11Compositor::initialize() {
         xtest_available = false;
     }
 
+    // Check for MIT-SHM extension (lets XShmGetImage write straight into shared memory
+    // instead of copying every captured frame over the X socket)
+    int shm_major, shm_minor;
+    Bool shm_pixmaps;
+    if (XShmQueryVersion(display, &shm_major, &shm_minor, &shm_pixmaps)) {
+        UtilityFunctions::print("MIT-SHM extension available: ", shm_major, ".", shm_minor);
+        shm_available = true;
+        shm_rejected = false;
+    } else {
+        UtilityFunctions::print("MIT-SHM extension not available (will use XGetImage instead)");
+        shm_available = false;
+    }
+
+    // Open a second connection for the capture thread, and set up every extension
+    // it uses here so the thread never has to initialize Xlib extension state
+    capture_display = XOpenDisplay(display_str);
+    if (!capture_display) {
+        UtilityFunctions::printerr("Failed to open capture connection to Xvfb display");
+        cleanup();
+        return false;
+    }
+
+    int ext_event_base, ext_error_base, ext_major, ext_minor;
+    if (composite_available) {
+        XCompositeQueryExtension(capture_display, &ext_event_base, &ext_error_base);
+        XCompositeQueryVersion(capture_display, &ext_major, &ext_minor);
+    }
+    if (damage_available) {
+        XDamageQueryExtension(capture_display, &ext_event_base, &ext_error_base);
+        XDamageQueryVersion(capture_display, &ext_major, &ext_minor);
+    }
+    if (xfixes_available) {
+        XFixesQueryExtension(capture_display, &ext_event_base, &ext_error_base);
+        XFixesQueryVersion(capture_display, &ext_major, &ext_minor);
+
+        // Scratch region that XDamageSubtract copies each window's damage into
+        damage_parts = XFixesCreateRegion(capture_display, nullptr, 0);
+    }
+    if (shm_available) {
+        XShmQueryExtension(capture_display);
+    }
+    if (render_available) {
+        XRenderQueryExtension(capture_display, &ext_event_base, &ext_error_base);
+    }
+
+    // Errors on the capture connection (e.g. a window destroyed mid-capture) are expected
+    capture_error_display = capture_display;
+    previous_error_handler = XSetErrorHandler(handle_capture_errors);
+
     // Select events on root window to track window creation/destruction
     // Note: We use SubstructureNotifyMask to get notifications about window changes
     // We do NOT use SubstructureRedirectMask because that would make us a window manager
@@ -316,6 +610,8 @@ bool X11Compositor::initialize() {
     // Scan for existing windows
     scan_existing_windows();
 
+    start_capture_thread();
+
     initialized = true;
     UtilityFunctions::print("X11Compositor initialized successfully");
     UtilityFunctions::print("Tracking ", (int)windows.size(), " windows");
@@ -323,6 +619,170 @@ bool X11Compositor::initialize() {
     return true;
 }
 
+void X11Compositor::set_framebuffer_capture_enabled(bool enabled) {
+    if (initialized && enabled != framebuffer_capture) {
+        UtilityFunctions::print("framebuffer_capture_enabled takes effect the next time the compositor initializes");
+    }
+    framebuffer_capture = enabled;
+}
+
+bool X11Compositor::is_framebuffer_capture_enabled() const {
+    return framebuffer_capture;
+}
+
+// Bit set in WindowCapture::framebuffer_placement when the low 32 bits hold
+// a screen position (y << 16 | x)
+static const uint64_t FRAMEBUFFER_PLACEMENT_VALID = 1ULL << 32;
+
+void X11Compositor::track_stacking(XEvent *event) {
+    auto find = [this](X11WindowHandle xwin) {
+        for (size_t i = 0; i < stacking.size(); i++) {
+            if (stacking[i].xwindow == xwin) {
+                return (int)i;
+            }
+        }
+        return -1;
+    };
+
+    // Tracked windows also report on themselves; only the root's copy of each
+    // event matters here
+    switch (event->type) {
+        case CreateNotify: {
+            XCreateWindowEvent &e = event->xcreatewindow;
+            if (e.parent != root_window || find(e.window) >= 0) {
+                return;
+            }
+            stacking.push_back({e.window, e.x, e.y, e.width, e.height, e.border_width, false});
+            break;
+        }
+        case DestroyNotify: {
+            int index = find(event->xdestroywindow.window);
+            if (index < 0) {
+                return;
+            }
+            stacking.erase(stacking.begin() + index);
+            break;
+        }
+        case MapNotify:
+        case UnmapNotify: {
+            bool mapped = event->type == MapNotify;
+            int index = find(mapped ? event->xmap.window : event->xunmap.window);
+            if (index < 0 || stacking[index].mapped == mapped) {
+                return;
+            }
+            stacking[index].mapped = mapped;
+            break;
+        }
+        case ConfigureNotify: {
+            XConfigureEvent &e = event->xconfigure;
+            int index = find(e.window);
+            if (e.event != root_window || index < 0) {
+                return;
+            }
+            StackedWindow entry = stacking[index];
+            entry.x = e.x;
+            entry.y = e.y;
+            entry.width = e.width;
+            entry.height = e.height;
+            entry.border = e.border_width;
+
+            // Restack directly above `above`, or at the bottom if there is none
+            stacking.erase(stacking.begin() + index);
+            int above = e.above != None ? find(e.above) : -1;
+            stacking.insert(stacking.begin() + (above + 1), entry);
+            break;
+        }
+        case CirculateNotify: {
+            XCirculateEvent &e = event->xcirculate;
+            int index = find(e.window);
+            if (e.event != root_window || index < 0) {
+                return;
+            }
+            StackedWindow entry = stacking[index];
+            stacking.erase(stacking.begin() + index);
+            if (e.place == PlaceOnTop) {
+                stacking.push_back(entry);
+            } else {
+                stacking.insert(stacking.begin(), entry);
+            }
+            break;
+        }
+        case ReparentNotify: {
+            XReparentEvent &e = event->xreparent;
+            int index = find(e.window);
+            if (e.parent == root_window && index < 0) {
+                WindowInfo info;
+                if (!query_window(e.window, &info)) {
+                    return;
+                }
+                stacking.push_back({e.window, e.x, e.y, info.width, info.height, info.border, info.viewable});
+            } else if (e.parent != root_window && index >= 0) {
+                stacking.erase(stacking.begin() + index);
+            } else {
+                return;
+            }
+            break;
+        }
+        default:
+            return;
+    }
+
+    stacking_dirty = true;
+}
+
+void X11Compositor::update_framebuffer_placement() {
+    stacking_dirty = false;
+
+    // Windows that aren't top-level stacking entries anymore (reparented into a
+    // frame) aren't where their old placement says, so they go back to the pixmap
+    FlatHashMap<unsigned long, bool> stacked;
+    for (const StackedWindow &entry : stacking) {
+        stacked[entry.xwindow] = true;
+    }
+    for (auto &pair : windows) {
+        if (stacked.find(pair.second->xwindow) == stacked.end()) {
+            pair.second->capture->framebuffer_placement = 0;
+        }
+    }
+
+    for (size_t i = 0; i < stacking.size(); i++) {
+        const StackedWindow &entry = stacking[i];
+        auto it = xwindow_to_id.find(entry.xwindow);
+        if (it == xwindow_to_id.end()) {
+            continue;
+        }
+        WindowCapture *capture = windows[it->second]->capture.get();
+
+        int outer_width = entry.width + 2 * entry.border;
+        int outer_height = entry.height + 2 * entry.border;
+        bool usable = entry.mapped && capture->depth == framebuffer.get_depth() &&
+                      entry.x >= 0 && entry.y >= 0 &&
+                      entry.x + outer_width <= framebuffer.get_width() &&
+                      entry.y + outer_height <= framebuffer.get_height();
+
+        // Anything mapped above it that overlaps hides part of it on screen
+        for (size_t j = i + 1; usable && j < stacking.size(); j++) {
+            const StackedWindow &other = stacking[j];
+            if (!other.mapped) {
+                continue;
+            }
+            int other_width = other.width + 2 * other.border;
+            int other_height = other.height + 2 * other.border;
+            if (other.x < entry.x + outer_width && entry.x < other.x + other_width &&
+                other.y < entry.y + outer_height && entry.y < other.y + other_height) {
+                usable = false;
+            }
+        }
+
+        uint64_t placement = 0;
+        if (usable) {
+            placement = FRAMEBUFFER_PLACEMENT_VALID |
+                        ((uint64_t)(entry.y + entry.border) << 16) | (uint64_t)(entry.x + entry.border);
+        }
+        capture->framebuffer_placement = placement;
+    }
+}
+
 void X11Compositor::scan_existing_windows() {
     X11WindowHandle returned_root, returned_parent;
     X11WindowHandle *children;
@@ -330,60 +790,88 @@ void X11Compositor::scan_existing_windows() {
 
     if (XQueryTree(display, root_window, &returned_root, &returned_parent,
                    &children, &num_children)) {
+        // Ask about every child before reading any reply: one round trip for the lot
+        std::vector<WindowQuery> queries;
+        queries.reserve(num_children);
         for (unsigned int i = 0; i < num_children; i++) {
-            if (should_track_window(children[i])) {
-                add_window(children[i]);
+            queries.push_back(window_query_send(xcb_connection, children[i], atoms));
+        }
+        std::vector<WindowInfo> infos(num_children);
+        std::vector<bool> valid(num_children);
+        for (unsigned int i = 0; i < num_children; i++) {
+            valid[i] = window_query_receive(xcb_connection, queries[i], &infos[i]);
+        }
+
+        // XQueryTree lists children bottom to top, which seeds the stacking order
+        if (framebuffer.is_open()) {
+            stacking.clear();
+            for (unsigned int i = 0; i < num_children; i++) {
+                if (valid[i]) {
+                    const WindowInfo &info = infos[i];
+                    stacking.push_back({children[i], info.x, info.y, info.width, info.height,
+                                        info.border, info.viewable});
+                }
+            }
+            stacking_dirty = true;
+        }
+
+        for (unsigned int i = 0; i < num_children; i++) {
+            if (valid[i] && should_track_window(infos[i])) {
+                add_window(children[i], infos[i]);
             }
         }
         XFree(children);
     }
 }
 
-bool X11Compositor::should_track_window(X11WindowHandle xwin) {
-    // Get window attributes
-    XWindowAttributes attrs;
-    if (!XGetWindowAttributes(display, xwin, &attrs)) {
-        return false;
-    }
+bool X11Compositor::query_window(X11WindowHandle xwin, WindowInfo *info) {
+    WindowQuery query = window_query_send(xcb_connection, xwin, atoms);
+    return window_query_receive(xcb_connection, query, info);
+}
 
+Visual *X11Compositor::find_visual(VisualID visual_id) {
+    // Answered from the connection setup data, no request involved
+    XVisualInfo visual_template;
+    visual_template.visualid = visual_id;
+    int count = 0;
+    XVisualInfo *visual_info = XGetVisualInfo(display, VisualIDMask, &visual_template, &count);
+    if (!visual_info) {
+        return nullptr;
+    }
+    Visual *visual = visual_info->visual;
+    XFree(visual_info);
+    return visual;
+}
+
+bool X11Compositor::should_track_window(const WindowInfo &info) {
     // Skip InputOnly windows (they have no visual content)
-    if (attrs.c_class == InputOnly) {
+    if (info.input_only) {
         return false;
     }
 
     // Skip tiny windows (< 10x10) which are likely internal/invisible windows
     // But DO track popup menus which can be as small as 50x20
-    if (attrs.width < 10 || attrs.height < 10) {
+    if (info.width < 10 || info.height < 10) {
         return false;
     }
 
-    // Check if window has WM_STATE property (indicates it's a managed window)
-    Atom wm_state = XInternAtom(display, "WM_STATE", False);
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop;
-
-    if (XGetWindowProperty(display, xwin, wm_state, 0, 0, False, AnyPropertyType,
-                          &actual_type, &actual_format, &nitems, &bytes_after, &prop) == Success) {
-        if (prop) XFree(prop);
-        if (actual_type != None) {
-            return true;  // Window has WM_STATE, so it's managed
-        }
+    // Windows with WM_STATE are managed
+    if (info.managed) {
+        return true;
     }
 
     // Also track mapped windows without WM_STATE (including popups)
-    return attrs.map_state == IsViewable;
+    return info.viewable;
 }
 
-void X11Compositor::add_window(X11WindowHandle xwin) {
+void X11Compositor::add_window(X11WindowHandle xwin, const WindowInfo &info) {
     // Check if already tracking
     if (xwindow_to_id.find(xwin) != xwindow_to_id.end()) {
         return;
     }
 
-    XWindowAttributes attrs;
-    if (!XGetWindowAttributes(display, xwin, &attrs)) {
+    Visual *visual = find_visual(info.visual);
+    if (!visual) {
         return;
     }
 
@@ -391,112 +879,103 @@ void X11Compositor::add_window(X11WindowHandle xwin) {
     X11Window *window = new X11Window();
     window->id = next_window_id++;
     window->xwindow = xwin;
-    window->width = attrs.width;
-    window->height = attrs.height;
-    window->x = attrs.x;
-    window->y = attrs.y;
-    window->mapped = (attrs.map_state == IsViewable);
-    window->has_image = false;
+    window->width = info.width;
+    window->height = info.height;
+    window->x = info.x;
+    window->y = info.y;
+    window->border = info.border;
+    window->parent_xwindow = root_window;  // Only root children are added; a WM may reparent them later
+    window->parent_origin_x = 0;
+    window->parent_origin_y = 0;
+    window->mapped = info.viewable;
     window->pid = -1;
     window->parent_window_id = -1;  // Default: no parent
     window->is_dialog = false;      // Default: not a dialog
-
-    // Get window title (WM_NAME)
-    char *window_name = nullptr;
-    XFetchName(display, xwin, &window_name);
-    window->wm_name = window_name ? String(window_name) : String("");
-    if (window_name) XFree(window_name);
-
-    // Get window class (WM_CLASS)
-    XClassHint class_hint;
-    if (XGetClassHint(display, xwin, &class_hint)) {
-        window->wm_class = class_hint.res_class ? String(class_hint.res_class) : String("");
-        if (class_hint.res_name) XFree(class_hint.res_name);
-        if (class_hint.res_class) XFree(class_hint.res_class);
-    } else {
-        window->wm_class = String("");
-    }
-
-    // Get PID (_NET_WM_PID property)
-    Atom pid_atom = XInternAtom(display, "_NET_WM_PID", False);
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop = nullptr;
-
-    if (XGetWindowProperty(display, xwin, pid_atom, 0, 1, False, XA_CARDINAL,
-                          &actual_type, &actual_format, &nitems, &bytes_after, &prop) == Success) {
-        if (prop && nitems > 0) {
-            window->pid = *((int*)prop);
-        }
-        if (prop) XFree(prop);
-    }
+    window->image_sequence = 0;
+    window->texture_sequence = 0;
+    window->thumbnail_sequence = 0;
+    window->texture_width = 0;
+    window->texture_height = 0;
+    window->tile_columns = 0;
+    window->tile_rows = 0;
+
+    // Capture state shared with the capture thread
+    window->capture = std::make_shared<WindowCapture>();
+    window->capture->xwindow = xwin;
+    window->capture->damage = None;
+    window->capture->visual = visual;
+    window->capture->depth = info.depth;
+
+    // ARGB visuals (tooltips, rounded menus, translucent terminals) carry real alpha
+    XRenderPictFormat *pict_format = render_available ? XRenderFindVisualFormat(display, visual) : nullptr;
+    window->capture->has_alpha = pict_format && pict_format->type == PictTypeDirect &&
+                                 pict_format->direct.alphaMask != 0;
+    window->capture->mapped = window->mapped;
+    window->capture->size = ((uint32_t)window->width << 16) | (uint32_t)window->height;
+
+    // Title, class, PID and hints came back with the same query
+    window->wm_name = String(info.name.c_str());
+    window->wm_class = String(info.wm_class.c_str());
+    window->pid = info.pid;
 
     // Check for parent window (WM_TRANSIENT_FOR property)
     // This indicates this window is a popup/dialog for another window
-    Atom transient_atom = XInternAtom(display, "WM_TRANSIENT_FOR", False);
-    X11WindowHandle parent_xwin = None;
-
-    prop = nullptr;
-    if (XGetWindowProperty(display, xwin, transient_atom, 0, 1, False, XA_WINDOW,
-                          &actual_type, &actual_format, &nitems, &bytes_after, &prop) == Success) {
-        if (prop && nitems > 0) {
-            parent_xwin = *((X11WindowHandle*)prop);
-
-            // Look up our internal window ID for this parent
-            auto parent_it = xwindow_to_id.find(parent_xwin);
-            if (parent_it != xwindow_to_id.end()) {
-                window->parent_window_id = parent_it->second;
-                UtilityFunctions::print("  Window is transient for window ", window->parent_window_id);
-            }
+    if (info.transient_for) {
+        // Look up our internal window ID for this parent
+        auto parent_it = xwindow_to_id.find(info.transient_for);
+        if (parent_it != xwindow_to_id.end()) {
+            window->parent_window_id = parent_it->second;
+            UtilityFunctions::print("  Window is transient for window ", window->parent_window_id);
         }
-        if (prop) XFree(prop);
     }
 
     // Check window type (_NET_WM_WINDOW_TYPE) to identify dialogs/menus
     // even if WM_TRANSIENT_FOR isn't set
-    Atom window_type_atom = XInternAtom(display, "_NET_WM_WINDOW_TYPE", False);
-    Atom dialog_atom = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-    Atom utility_atom = XInternAtom(display, "_NET_WM_WINDOW_TYPE_UTILITY", False);
-    Atom menu_atom = XInternAtom(display, "_NET_WM_WINDOW_TYPE_MENU", False);
-    Atom popup_menu_atom = XInternAtom(display, "_NET_WM_WINDOW_TYPE_POPUP_MENU", False);
-
-    prop = nullptr;
-    if (XGetWindowProperty(display, xwin, window_type_atom, 0, 32, False, XA_ATOM,
-                          &actual_type, &actual_format, &nitems, &bytes_after, &prop) == Success) {
-        if (prop && nitems > 0) {
-            Atom *types = (Atom*)prop;
-            for (unsigned long i = 0; i < nitems; i++) {
-                if (types[i] == dialog_atom) {
-                    window->is_dialog = true;
-                    UtilityFunctions::print("  Window type: DIALOG");
-                } else if (types[i] == utility_atom) {
-                    window->is_dialog = true;
-                    UtilityFunctions::print("  Window type: UTILITY");
-                } else if (types[i] == menu_atom || types[i] == popup_menu_atom) {
-                    window->is_dialog = true;
-                    UtilityFunctions::print("  Window type: MENU/POPUP_MENU");
-                }
-            }
+    for (xcb_atom_t type : info.types) {
+        if (type == atoms[ATOM_NET_WM_WINDOW_TYPE_DIALOG]) {
+            window->is_dialog = true;
+            UtilityFunctions::print("  Window type: DIALOG");
+        } else if (type == atoms[ATOM_NET_WM_WINDOW_TYPE_UTILITY]) {
+            window->is_dialog = true;
+            UtilityFunctions::print("  Window type: UTILITY");
+        } else if (type == atoms[ATOM_NET_WM_WINDOW_TYPE_MENU] || type == atoms[ATOM_NET_WM_WINDOW_TYPE_POPUP_MENU]) {
+            window->is_dialog = true;
+            UtilityFunctions::print("  Window type: MENU/POPUP_MENU");
         }
-        if (prop) XFree(prop);
     }
 
     // Set up damage tracking if available
     if (damage_available) {
         window->damage = XDamageCreate(display, xwin, XDamageReportNonEmpty);
+        window->capture->damage = window->damage;
     }
 
-    // Select events for this window
-    XSelectInput(display, xwin, StructureNotifyMask);
+    // Select events for this window (PropertyChangeMask for title changes)
+    XSelectInput(display, xwin, StructureNotifyMask | PropertyChangeMask);
 
     // Store in our maps
     windows[window->id] = window;
     xwindow_to_id[xwin] = window->id;
+    if (window->damage) {
+        damage_to_window[window->damage] = window;
+    }
+
+    // The capture thread uses the damage object from its own connection,
+    // so make sure the server has seen it
+    XFlush(display);
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex);
+        capture_jobs.push_back(window->capture);
+    }
+    capture_wanted = true;
+    stacking_dirty = framebuffer.is_open();  // Work out whether it can be read off the screen
+    window_generation++;
 
     UtilityFunctions::print("Tracking window ", window->id, ": ",
                            window->wm_name, " [", window->wm_class, "] ",
                            " (", window->width, "x", window->height, ")");
+
+    emit_signal("window_created", window->id);
 }
 
 // Error handler to ignore BadDamage and BadWindow errors during cleanup
@@ -512,6 +991,102 @@ static int ignore_cleanup_errors(Display *display, XErrorEvent *error) {
     return 0;  // Actually, just ignore all errors during cleanup
 }
 
+bool X11Compositor::create_shm_image(WindowCapture *capture) {
+    if (!shm_available || shm_rejected || capture->image_width <= 0 || capture->image_height <= 0) {
+        destroy_shm_image(capture);
+        return false;
+    }
+
+    XImage *image = XShmCreateImage(capture_display, capture->visual, capture->depth, ZPixmap,
+                                    nullptr, &capture->shm_info, capture->image_width, capture->image_height);
+    if (!image) {
+        destroy_shm_image(capture);
+        return false;
+    }
+
+    // Resizing within the current segment only needs a new image header - no
+    // shmget/attach round trip while a window edge is being dragged
+    size_t bytes = (size_t)image->bytes_per_line * image->height;
+    if (capture->shm_image && bytes <= capture->shm_capacity && bytes * 4 >= capture->shm_capacity) {
+        image->data = capture->shm_info.shmaddr;
+        capture->shm_image->data = nullptr;
+        XDestroyImage(capture->shm_image);
+        capture->shm_image = image;
+        shm_segment_reuses++;
+        return true;
+    }
+    destroy_shm_image(capture);
+
+    // Segments come in the buffer pool's size classes for the same reason
+    size_t capacity = BufferPool::round_size(bytes);
+    capture->shm_info.shmid = shmget(IPC_PRIVATE, capacity, IPC_CREAT | 0600);
+    if (capture->shm_info.shmid < 0) {
+        XDestroyImage(image);
+        return false;
+    }
+
+    capture->shm_info.shmaddr = image->data = (char*)shmat(capture->shm_info.shmid, nullptr, 0);
+    if (capture->shm_info.shmaddr == (char*)-1) {
+        shmctl(capture->shm_info.shmid, IPC_RMID, nullptr);
+        image->data = nullptr;
+        XDestroyImage(image);
+        return false;
+    }
+    capture->shm_info.readOnly = False;
+
+    // Attach synchronously so we find out right away if the server rejected it
+    int errors_before = capture_error_count.load();
+    XShmAttach(capture_display, &capture->shm_info);
+    XSync(capture_display, False);
+
+    // Mark the segment for removal now; it is freed once both sides detach
+    shmctl(capture->shm_info.shmid, IPC_RMID, nullptr);
+
+    if (capture_error_count.load() != errors_before) {
+        // A server that rejects one attach rejects them all; don't pay for
+        // shmget/attach/XSync again on every capture
+        UtilityFunctions::print("XShmAttach failed for window 0x", String::num_int64(capture->xwindow, 16),
+                                ", using XGetImage from now on");
+        shm_rejected = true;
+        shmdt(capture->shm_info.shmaddr);
+        image->data = nullptr;
+        XDestroyImage(image);
+        return false;
+    }
+
+    capture->shm_image = image;
+    capture->shm_capacity = capacity;
+
+    // Partial captures read into this one after setting its size, so they
+    // don't create and destroy a header every time
+    capture->shm_sub_image = XShmCreateImage(capture_display, capture->visual, capture->depth, ZPixmap,
+                                             nullptr, &capture->shm_info, capture->image_width,
+                                             capture->image_height);
+    if (capture->shm_sub_image) {
+        capture->shm_sub_image->data = capture->shm_info.shmaddr;
+    }
+    return true;
+}
+
+void X11Compositor::destroy_shm_image(WindowCapture *capture) {
+    if (!capture->shm_image) {
+        return;
+    }
+
+    XShmDetach(capture_display, &capture->shm_info);
+    shmdt(capture->shm_info.shmaddr);
+    // XDestroyImage would free() the SHM data pointer
+    capture->shm_image->data = nullptr;
+    XDestroyImage(capture->shm_image);
+    capture->shm_image = nullptr;
+    if (capture->shm_sub_image) {
+        capture->shm_sub_image->data = nullptr;
+        XDestroyImage(capture->shm_sub_image);
+        capture->shm_sub_image = nullptr;
+    }
+    capture->shm_capacity = 0;
+}
+
 void X11Compositor::remove_window(X11WindowHandle xwin) {
     auto it = xwindow_to_id.find(xwin);
     if (it == xwindow_to_id.end()) {
@@ -537,16 +1112,40 @@ void X11Compositor::remove_window(X11WindowHandle xwin) {
         XSetErrorHandler(old_handler);
     }
 
+    // Hand the capture state back to the capture thread, which frees its
+    // SHM segment (that belongs to the capture connection)
+    window->capture->mapped = false;
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex);
+        capture_jobs.erase(std::remove(capture_jobs.begin(), capture_jobs.end(), window->capture),
+                           capture_jobs.end());
+        capture_retired.push_back(window->capture);
+    }
+    capture_wanted = true;
+
+    // Queued input can't be delivered to it anymore
+    input_queue.erase(std::remove_if(input_queue.begin(), input_queue.end(),
+                                     [xwin](const QueuedInput &input) { return input.xwindow == xwin; }),
+                      input_queue.end());
+
     // Remove from maps
     windows.erase(window_id);
     xwindow_to_id.erase(xwin);
+    if (window->damage) {
+        damage_to_window.erase(window->damage);
+    }
 
+    free_window_textures(window);
     delete window;
+    window_generation++;
+
+    emit_signal("window_destroyed", window_id);
 }
 
 void X11Compositor::handle_create_notify(XCreateWindowEvent *event) {
-    if (should_track_window(event->window)) {
-        add_window(event->window);
+    WindowInfo info;
+    if (query_window(event->window, &info) && should_track_window(info)) {
+        add_window(event->window, info);
     }
 }
 
@@ -558,11 +1157,23 @@ void X11Compositor::handle_map_notify(XMapEvent *event) {
     auto it = xwindow_to_id.find(event->window);
     if (it != xwindow_to_id.end()) {
         X11Window *window = windows[it->second];
+        // We hear about each map twice (root SubstructureNotify + window StructureNotify)
+        if (window->mapped) {
+            return;
+        }
         window->mapped = true;
+        window->capture->mapped = true;
+        window->capture->pixmap_generation++;  // Mapping gives the window a new backing pixmap
+        capture_wanted = true;
+        window_generation++;
         UtilityFunctions::print("Window ", window->id, " mapped");
-    } else if (should_track_window(event->window)) {
+        emit_signal("window_mapped", window->id);
+    } else {
         // New window that just became visible
-        add_window(event->window);
+        WindowInfo info;
+        if (query_window(event->window, &info) && should_track_window(info)) {
+            add_window(event->window, info);
+        }
     }
 }
 
@@ -570,179 +1181,1551 @@ void X11Compositor::handle_unmap_notify(XUnmapEvent *event) {
     auto it = xwindow_to_id.find(event->window);
     if (it != xwindow_to_id.end()) {
         X11Window *window = windows[it->second];
+        if (!window->mapped) {
+            return;
+        }
         window->mapped = false;
+        window->capture->mapped = false;
+        window_generation++;
         UtilityFunctions::print("Window ", window->id, " unmapped");
+        emit_signal("window_unmapped", window->id);
     }
 }
 
 void X11Compositor::handle_configure_notify(XConfigureEvent *event) {
     auto it = xwindow_to_id.find(event->window);
-    if (it != xwindow_to_id.end()) {
-        X11Window *window = windows[it->second];
-
-        bool size_changed = (window->width != event->width || window->height != event->height);
-
-        window->width = event->width;
-        window->height = event->height;
-        window->x = event->x;
-        window->y = event->y;
-
-        if (size_changed) {
-            UtilityFunctions::print("Window ", window->id, " resized to ",
-                                   window->width, "x", window->height);
-            // Invalidate cached image on size change
-            window->has_image = false;
+    if (it == xwindow_to_id.end()) {
+        // Not ours, but it may be a window manager frame one of ours sits in
+        if (event->event == root_window) {
+            move_frame_children(event->window, event->x + event->border_width, event->y + event->border_width);
         }
+        return;
+    }
+    X11Window *window = windows[it->second];
+
+    if (event->send_event) {
+        // ICCCM 4.1.5: a window manager that moves the frame without moving the client
+        // inside it sends a synthetic event with the client's root coordinates.
+        // x/y stay parent-relative, so this only tells us where the parent is.
+        int origin_x = event->x + event->border_width - window->x - window->border;
+        int origin_y = event->y + event->border_width - window->y - window->border;
+        if (origin_x != window->parent_origin_x || origin_y != window->parent_origin_y) {
+            window->parent_origin_x = origin_x;
+            window->parent_origin_y = origin_y;
+            window_generation++;
+            emit_window_moved(window);
+        }
+        return;
     }
-}
 
-void X11Compositor::handle_damage_notify(XDamageNotifyEvent *event) {
-    // Find window by damage object
-    for (auto &pair : windows) {
-        X11Window *window = pair.second;
-        if (window->damage == event->damage) {
-            // Window has been damaged, needs re-capture
-            // Subtract the damage
-            XDamageSubtract(display, window->damage, None, None);
+    bool size_changed = (window->width != event->width || window->height != event->height);
+    bool position_changed = (window->x != event->x || window->y != event->y ||
+                             window->border != event->border_width);
 
-            // Mark for recapture
-            window->has_image = false;
-            break;
-        }
+    window->width = event->width;
+    window->height = event->height;
+    window->x = event->x;
+    window->y = event->y;
+    window->border = event->border_width;
+    if (size_changed || position_changed) {
+        window_generation++;
     }
-}
 
-void X11Compositor::capture_window_contents(X11Window *window) {
-    if (!composite_available || !window->mapped) {
-        return;
+    if (size_changed) {
+        UtilityFunctions::print("Window ", window->id, " resized to ",
+                               window->width, "x", window->height);
+        // The capture thread notices the new size and does a full recapture
+        // (re-naming the composite pixmap and recreating its SHM segment)
+        window->capture->size = ((uint32_t)window->width << 16) | (uint32_t)window->height;
+        window->capture->pixmap_generation++;
+        capture_wanted = true;
+        emit_signal("window_resized", window->id, Vector2i(window->width, window->height));
     }
 
-    // Skip if we already have a valid image and no damage
-    if (window->has_image && damage_available) {
-        return;
+    if (position_changed) {
+        emit_window_moved(window);
     }
+}
 
-    if (window->width <= 0 || window->height <= 0) {
+void X11Compositor::handle_reparent_notify(XReparentEvent *event) {
+    auto it = xwindow_to_id.find(event->window);
+    if (it == xwindow_to_id.end()) {
         return;
     }
+    X11Window *window = windows[it->second];
 
-    // Get the window's composite pixmap (off-screen buffer)
-    Pixmap pixmap = XCompositeNameWindowPixmap(display, window->xwindow);
-    if (!pixmap) {
+    // We hear about it twice when the root is the old or new parent
+    if (window->parent_xwindow == event->parent && window->x == event->x && window->y == event->y) {
         return;
     }
 
-    // Get an XImage from the pixmap
-    XImage *image = XGetImage(display, pixmap, 0, 0, window->width, window->height,
-                              AllPlanes, ZPixmap);
+    int origin_x = 0, origin_y = 0;
+    if (event->parent != root_window &&
+        !window_root_origin(xcb_connection, event->parent, root_window, &origin_x, &origin_y)) {
+        return;  // The new parent is already gone; its DestroyNotify takes the window with it
+    }
 
-    if (!image) {
-        XFreePixmap(display, pixmap);
-        return;
+    // One round trip per reparent; from here on the frame's ConfigureNotify keeps the origin current
+    Vector2i old_position = cached_root_position(window);
+    window->parent_xwindow = event->parent;
+    window->parent_origin_x = origin_x;
+    window->parent_origin_y = origin_y;
+    window->x = event->x;
+    window->y = event->y;
+    window_generation++;
+    if (cached_root_position(window) != old_position) {
+        emit_window_moved(window);
     }
+}
 
-    // Convert XImage to RGBA format
-    size_t size = window->width * window->height * 4;
-    window->image_data.resize(size);
-
-    // Convert based on image format
-    // Most X11 servers use 32-bit BGRA or BGRX format
-    if (image->bits_per_pixel == 32) {
-        // Access the raw pixel data directly
-        // For 32bpp with depth 24, format is typically BGRX (LSB first) or XBGR (MSB first)
-        uint8_t *src = (uint8_t*)image->data;
-        int bytes_per_pixel = image->bits_per_pixel / 8;
-
-        // Debug: Sample a few pixels to see what we're getting
-        static bool printed_samples = false;
-        if (!printed_samples && window->width > 10 && window->height > 10) {
-            // Sample pixel at (10, 10)
-            int sample_idx = (10 * image->bytes_per_line) + (10 * bytes_per_pixel);
-            UtilityFunctions::print("Sample pixel at (10,10): [0]=", (int)src[sample_idx+0],
-                                   " [1]=", (int)src[sample_idx+1],
-                                   " [2]=", (int)src[sample_idx+2],
-                                   " [3]=", (int)src[sample_idx+3]);
-            printed_samples = true;
-        }
-
-        for (int y = 0; y < window->height; y++) {
-            for (int x = 0; x < window->width; x++) {
-                // Calculate source offset in the XImage data
-                int src_idx = (y * image->bytes_per_line) + (x * bytes_per_pixel);
-
-                // Calculate destination offset in our RGBA buffer
-                size_t dst_idx = (y * window->width + x) * 4;
-
-                // Read pixel data - try different byte orders
-                uint8_t byte0 = src[src_idx + 0];
-                uint8_t byte1 = src[src_idx + 1];
-                uint8_t byte2 = src[src_idx + 2];
-                uint8_t byte3 = src[src_idx + 3];
-
-                // Write to RGBA format for Godot
-                // Let's try: byte0=B, byte1=G, byte2=R (standard BGRA)
-                window->image_data[dst_idx + 0] = byte2;  // R
-                window->image_data[dst_idx + 1] = byte1;  // G
-                window->image_data[dst_idx + 2] = byte0;  // B
-                window->image_data[dst_idx + 3] = 255;     // A
-            }
+void X11Compositor::move_frame_children(X11WindowHandle frame, int origin_x, int origin_y) {
+    for (auto &pair : windows) {
+        X11Window *window = pair.second;
+        if (window->parent_xwindow == frame &&
+            (window->parent_origin_x != origin_x || window->parent_origin_y != origin_y)) {
+            window->parent_origin_x = origin_x;
+            window->parent_origin_y = origin_y;
+            window_generation++;
+            emit_window_moved(window);
         }
-        window->has_image = true;
-    } else {
-        UtilityFunctions::printerr("Unsupported image format: ", image->bits_per_pixel, " bits per pixel");
     }
+}
 
-    XDestroyImage(image);
-    XFreePixmap(display, pixmap);
+Vector2i X11Compositor::cached_root_position(const X11Window *window) {
+    return Vector2i(window->parent_origin_x + window->x + window->border,
+                    window->parent_origin_y + window->y + window->border);
 }
 
-TypedArray<int> X11Compositor::get_window_ids() {
-    TypedArray<int> ids;
-    for (const auto &pair : windows) {
-        ids.push_back(pair.first);
-    }
-    return ids;
+void X11Compositor::emit_window_moved(X11Window *window) {
+    emit_signal("window_moved", window->id, cached_root_position(window));
 }
 
-Ref<Image> X11Compositor::get_window_buffer(int window_id) {
-    auto it = windows.find(window_id);
-    if (it == windows.end()) {
-        return Ref<Image>();
+Vector2i X11Compositor::window_root_position(X11Window *window) {
+    Vector2i position = cached_root_position(window);
+
+    // Unmapped windows are skipped: the server may already have destroyed them.
+    // Events still waiting in the queue can make a single check disagree.
+    if (verify_window_positions && window->mapped) {
+        int x, y;
+        if (window_root_origin(xcb_connection, window->xwindow, root_window, &x, &y) &&
+            (x != position.x || y != position.y)) {
+            position_mismatches++;
+            UtilityFunctions::printerr("Window ", window->id, " cached position (", position.x, ",", position.y,
+                                       ") differs from the server's (", x, ",", y, ")");
+            // Take the server's word so the same miss isn't reported on every lookup
+            window->parent_origin_x += x - position.x;
+            window->parent_origin_y += y - position.y;
+            window_generation++;
+            emit_window_moved(window);
+            position = Vector2i(x, y);
+        }
     }
+    return position;
+}
 
+void X11Compositor::handle_damage_notify(XDamageNotifyEvent *event) {
+    // Find window by damage object
+    auto it = damage_to_window.find(event->damage);
+    if (it == damage_to_window.end()) {
+        return;
+    }
     X11Window *window = it->second;
 
-    if (!window->has_image || window->image_data.empty()) {
-        return Ref<Image>();
+    // Window has been damaged, needs re-capture.
+    // The damage stays accumulated on the server (ReportNonEmpty won't notify
+    // again until it's subtracted), so capture_window_contents can fetch the
+    // exact region in one go.
+    window->capture->damaged = true;
+    capture_wanted = true;
+    emit_signal("window_damaged", window->id,
+                Rect2i(event->area.x, event->area.y, event->area.width, event->area.height));
+}
+
+void X11Compositor::handle_property_notify(XPropertyEvent *event) {
+    if (event->atom != XA_WM_NAME) {
+        return;
     }
 
-    if (window->width <= 0 || window->height <= 0) {
-        return Ref<Image>();
+    auto it = xwindow_to_id.find(event->window);
+    if (it == xwindow_to_id.end()) {
+        return;
     }
+    X11Window *window = windows[it->second];
+
+    // Don't wait for the new title here; receive_titles picks it up once it arrives
+    pending_titles.emplace_back(window->xwindow, window_name_send(xcb_connection, window->xwindow));
+}
 
-    // Create PackedByteArray from cached image data
-    PackedByteArray image_data;
-    image_data.resize(window->image_data.size());
-    memcpy(image_data.ptrw(), window->image_data.data(), window->image_data.size());
+void X11Compositor::receive_titles() {
+    xcb_flush(xcb_connection);
 
-    // Create Godot Image
-    Ref<Image> image = Image::create_from_data(window->width, window->height,
-                                               false, Image::FORMAT_RGBA8, image_data);
+    // Replies come back in request order, so stop at the first one still in flight
+    size_t received = 0;
+    for (; received < pending_titles.size(); received++) {
+        std::string name;
+        if (!window_name_poll(xcb_connection, pending_titles[received].second, &name)) {
+            break;
+        }
+
+        auto it = xwindow_to_id.find(pending_titles[received].first);
+        if (it == xwindow_to_id.end()) {
+            continue;  // Destroyed while the request was in flight
+        }
+        X11Window *window = windows[it->second];
 
-    return image;
+        String title = String(name.c_str());
+        if (title != window->wm_name) {
+            window->wm_name = title;
+            window_generation++;
+            emit_signal("title_changed", window->id, title);
+        }
+    }
+    pending_titles.erase(pending_titles.begin(), pending_titles.begin() + received);
 }
 
-Vector2i X11Compositor::get_window_size(int window_id) {
-    auto it = windows.find(window_id);
-    if (it == windows.end()) {
-        return Vector2i(0, 0);
+// Work out the source layout of an XImage captured from a window. Pixmap images
+// carry no channel masks, so they come from the window's visual.
+// Returns false if the layout isn't one we convert.
+static bool image_pixel_format(const XImage *image, const WindowCapture *capture, PixelFormat *format) {
+    if (image->byte_order != LSBFirst) {
+        return false;
     }
 
-    X11Window *window = it->second;
-    return Vector2i(window->width, window->height);
-}
+    const Visual *visual = capture->visual;
+    bool rgb888 = visual->red_mask == 0xFF0000 && visual->green_mask == 0xFF00 && visual->blue_mask == 0xFF;
+    bool rgb565 = visual->red_mask == 0xF800 && visual->green_mask == 0x7E0 && visual->blue_mask == 0x1F;
 
-String X11Compositor::get_display_name() {
+    if (image->bits_per_pixel == 32 && rgb888) {
+        // ARGB visuals hold premultiplied alpha; everything else has a padding byte
+        *format = capture->has_alpha ? PIXEL_FORMAT_BGRA_PREMULTIPLIED : PIXEL_FORMAT_BGRX;
+    } else if (image->bits_per_pixel == 24 && rgb888) {
+        *format = PIXEL_FORMAT_BGR24;
+    } else if (image->bits_per_pixel == 16 && rgb565) {
+        *format = PIXEL_FORMAT_RGB565;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Convert a rectangle of an XImage into the window's RGBA buffer
+// Returns false if the image format isn't supported
+static bool convert_image_rect(const XImage *image, const WindowCapture *capture, int src_x, int src_y,
+                               uint8_t *dst, int dst_width, int dst_x, int dst_y,
+                               int width, int height) {
+    PixelFormat format;
+    if (!image_pixel_format(image, capture, &format)) {
+        return false;
+    }
+
+    const uint8_t *src = (const uint8_t*)image->data + (size_t)src_y * image->bytes_per_line +
+                         (size_t)src_x * pixel_format_bytes(format);
+    uint8_t *dst_start = dst + ((size_t)dst_y * dst_width + dst_x) * 4;
+
+    pixel_convert_rect(src, image->bytes_per_line, dst_start, (size_t)dst_width * 4,
+                       width, height, format);
+    return true;
+}
+
+// Append a rectangle to a dirty list, collapsing to the bounding box if the list gets long
+static void add_dirty_rect(std::vector<XRectangle> &rects, const XRectangle &rect) {
+    const size_t MAX_DIRTY_RECTS = 64;
+
+    if (rects.size() < MAX_DIRTY_RECTS) {
+        rects.push_back(rect);
+        return;
+    }
+
+    int x1 = rect.x, y1 = rect.y;
+    int x2 = rect.x + rect.width, y2 = rect.y + rect.height;
+    for (const XRectangle &r : rects) {
+        x1 = std::min(x1, (int)r.x);
+        y1 = std::min(y1, (int)r.y);
+        x2 = std::max(x2, r.x + r.width);
+        y2 = std::max(y2, r.y + r.height);
+    }
+    rects.clear();
+    rects.push_back({(short)x1, (short)y1, (unsigned short)(x2 - x1), (unsigned short)(y2 - y1)});
+}
+
+// Frames a thumbnail request stays live; after that the capture thread stops producing it
+static const uint64_t THUMBNAIL_REQUEST_FRAMES = 120;
+
+bool X11Compositor::needs_capture(WindowCapture *capture, int64_t *next_capture_usec) {
+    if (!capture->mapped || capture->interest == WINDOW_INTEREST_HIDDEN || capture->unsupported_format) {
+        return false;
+    }
+
+    uint32_t packed_size = capture->size;
+    int width = packed_size >> 16;
+    int height = packed_size & 0xFFFF;
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    int capture_width, capture_height;
+    get_capture_size(capture, width, height, &capture_width, &capture_height);
+    bool size_changed = capture->image_width != capture_width || capture->image_height != capture_height;
+
+    // Polling mode, first capture, resize/LOD change, pending damage, or a
+    // framebuffer read that needs confirming
+    if (damage_available && !size_changed && !capture->damaged && capture->framebuffer_recheck.empty()) {
+        return false;
+    }
+
+    // Rate-limited windows (LOD, thumbnails) don't need every frame. The capture
+    // thread wakes up when the earliest deferred one is due and picks up the
+    // accumulated damage then.
+    if (!size_changed) {
+        int64_t interval = capture->lod_interval_usec;
+        if (capture->interest == WINDOW_INTEREST_THUMBNAIL) {
+            interval = std::max(interval, thumbnail_interval_usec.load());
+        }
+        int64_t due = capture->last_capture_usec + interval;
+        if (interval > 0 && steady_usec() < due) {
+            if (next_capture_usec && (!*next_capture_usec || due < *next_capture_usec)) {
+                *next_capture_usec = due;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void X11Compositor::get_capture_size(WindowCapture *capture, int width, int height,
+                                     int *capture_width, int *capture_height) {
+    *capture_width = width;
+    *capture_height = height;
+
+    // Downscaling happens on the server, so without XRender we capture at full size
+    uint32_t max_pixels = capture->lod_max_pixels;
+    if (!render_available || max_pixels == 0 || (uint64_t)width * height <= max_pixels) {
+        return;
+    }
+
+    double scale = std::sqrt((double)max_pixels / ((double)width * height));
+    *capture_width = std::max(1, (int)(width * scale));
+    *capture_height = std::max(1, (int)(height * scale));
+}
+
+Pixmap X11Compositor::update_scaled_pixmap(WindowCapture *capture, int source_width, int source_height,
+                                           int width, int height) {
+    XRenderPictFormat *format = XRenderFindVisualFormat(capture_display, capture->visual);
+    if (!format) {
+        return None;
+    }
+
+    XRenderPictureAttributes attributes = {};
+    if (!capture->pixmap_picture) {
+        capture->pixmap_picture = XRenderCreatePicture(capture_display, capture->pixmap, format, 0, &attributes);
+        XRenderSetPictureFilter(capture_display, capture->pixmap_picture, (char*)FilterBilinear, nullptr, 0);
+    }
+
+    // The scaling target is kept until the LOD resolution changes
+    if (!capture->scaled_pixmap || capture->scaled_width != width || capture->scaled_height != height) {
+        if (capture->scaled_picture) {
+            XRenderFreePicture(capture_display, capture->scaled_picture);
+        }
+        if (capture->scaled_pixmap) {
+            XFreePixmap(capture_display, capture->scaled_pixmap);
+        }
+        capture->scaled_pixmap = XCreatePixmap(capture_display, capture->xwindow, width, height, capture->depth);
+        capture->scaled_picture = XRenderCreatePicture(capture_display, capture->scaled_pixmap, format, 0, &attributes);
+        capture->scaled_width = width;
+        capture->scaled_height = height;
+        pixmap_recreations++;
+    }
+
+    // The transform maps destination pixels back into the source
+    XTransform transform = {{
+        { XDoubleToFixed((double)source_width / width), 0, 0 },
+        { 0, XDoubleToFixed((double)source_height / height), 0 },
+        { 0, 0, XDoubleToFixed(1.0) },
+    }};
+    XRenderSetPictureTransform(capture_display, capture->pixmap_picture, &transform);
+    XRenderComposite(capture_display, PictOpSrc, capture->pixmap_picture, None, capture->scaled_picture,
+                     0, 0, 0, 0, 0, 0, width, height);
+
+    return capture->scaled_pixmap;
+}
+
+void X11Compositor::destroy_capture_pixmaps(WindowCapture *capture) {
+    if (capture->scaled_picture) {
+        XRenderFreePicture(capture_display, capture->scaled_picture);
+        capture->scaled_picture = None;
+    }
+    if (capture->scaled_pixmap) {
+        XFreePixmap(capture_display, capture->scaled_pixmap);
+        capture->scaled_pixmap = None;
+    }
+    if (capture->pixmap_picture) {
+        XRenderFreePicture(capture_display, capture->pixmap_picture);
+        capture->pixmap_picture = None;
+    }
+    if (capture->pixmap) {
+        XFreePixmap(capture_display, capture->pixmap);
+        capture->pixmap = None;
+    }
+}
+
+void X11Compositor::release_capture_resources(WindowCapture *capture) {
+    destroy_shm_image(capture);
+    destroy_capture_pixmaps(capture);
+    capture->image_data.release();  // Back to the pool for the next window
+}
+
+void X11Compositor::update_thumbnail(WindowCapture *capture, int64_t now_usec) {
+    // Only while someone is asking for it
+    uint64_t request = capture->thumbnail_request_frame;
+    if (request == 0 || frame_counter + 1 - request > THUMBNAIL_REQUEST_FRAMES) {
+        return;
+    }
+
+    // Nothing new to show, or refreshed too recently
+    if (capture->sequence == 0 || capture->thumbnail_sequence == capture->sequence ||
+        capture->memory_state != FRAME_MEMORY_WARM) {
+        return;
+    }
+    if (capture->thumbnail_sequence != 0 && now_usec - capture->last_thumbnail_usec < thumbnail_interval_usec) {
+        return;
+    }
+
+    int width = capture->image_width;
+    int height = capture->image_height;
+    int max_size = std::max(1, thumbnail_max_size.load());
+    int thumb_width = width;
+    int thumb_height = height;
+    if (width > max_size || height > max_size) {
+        if (width >= height) {
+            thumb_width = max_size;
+            thumb_height = std::max(1, (int)((int64_t)height * max_size / width));
+        } else {
+            thumb_height = max_size;
+            thumb_width = std::max(1, (int)((int64_t)width * max_size / height));
+        }
+    }
+
+    // Fresh buffer each time - the main thread may still be sharing the previous one
+    PackedByteArray pixels;
+    pixels.resize((int64_t)thumb_width * thumb_height * 4);
+    pixel_downscale_box(capture->image_data.data(), (size_t)width * 4, width, height,
+                        pixels.ptrw(), (size_t)thumb_width * 4, thumb_width, thumb_height);
+
+    {
+        std::lock_guard<std::mutex> lock(capture->thumbnail_mutex);
+        capture->thumbnail_pixels = pixels;
+        capture->thumbnail_width = thumb_width;
+        capture->thumbnail_height = thumb_height;
+        capture->thumbnail_sequence = capture->sequence;
+    }
+    capture->last_thumbnail_usec = now_usec;
+}
+
+bool X11Compositor::capture_from_framebuffer(WindowCapture *capture, uint64_t placement,
+                                             std::vector<XRectangle> &rects, bool full_capture) {
+    int screen_x = placement & 0xFFFF;
+    int screen_y = (placement >> 16) & 0xFFFF;
+    int width = capture->image_width;
+    int height = capture->image_height;
+
+    // The placement can trail a move or resize by a frame; let the pixmap path handle it
+    if (screen_x + width > framebuffer.get_width() || screen_y + height > framebuffer.get_height()) {
+        capture->framebuffer_recheck.clear();
+        return false;
+    }
+
+    // The server paints redirected windows onto the screen after it reports their
+    // damage, so this pass may see the old pixels. Read last pass's rects again;
+    // only rows that actually changed get published.
+    std::vector<XRectangle> damaged = rects;
+    for (const XRectangle &r : capture->framebuffer_recheck) {
+        add_dirty_rect(rects, r);
+    }
+
+    size_t stride = (size_t)width * 4;
+    std::vector<XRectangle> changed;
+    for (const XRectangle &r : rects) {
+        uint8_t *dst = capture->image_data.data() + (size_t)r.y * stride + (size_t)r.x * 4;
+        if (framebuffer.read_rect(screen_x + r.x, screen_y + r.y, r.width, r.height, dst, stride) || full_capture) {
+            add_dirty_rect(changed, r);
+        }
+    }
+    capture->framebuffer_recheck = damaged;
+    framebuffer_captures++;
+
+    // Rows were already compared, but the tile hashes have to follow every publish
+    if (!changed.empty() && drop_unchanged_tiles(capture, changed, &full_capture)) {
+        publish_frame(capture, changed, full_capture, CAPTURE_BACKEND_FRAMEBUFFER);
+    }
+    return true;
+}
+
+void X11Compositor::capture_window_contents(WindowCapture *capture) {
+    if (!composite_available || !capture->mapped) {
+        return;
+    }
+
+    if (!needs_capture(capture)) {
+        return;
+    }
+
+    // A parked frame has to be resident again before damage can be applied to it
+    if (capture->memory_state != FRAME_MEMORY_WARM) {
+        restore_frame(capture, false);
+    }
+
+    uint32_t packed_size = capture->size;
+    int window_width = packed_size >> 16;
+    int window_height = packed_size & 0xFFFF;
+
+    // Size of the captured image - smaller than the window when its LOD asks for it
+    int width, height;
+    get_capture_size(capture, window_width, window_height, &width, &height);
+    bool scaled = width != window_width || height != window_height;
+
+    // Without damage tracking we have to recapture everything every time.
+    // With it, we only need a full capture the first time (or after a resize).
+    // Scaled captures are always full, since damage is in window coordinates.
+    bool full_capture = !damage_available || scaled || capture->image_width != width ||
+                        capture->image_height != height;
+
+    // Unobscured windows at full resolution are read straight off the Xvfb screen
+    uint64_t placement = scaled ? 0 : capture->framebuffer_placement.load();
+    if (!placement || full_capture) {
+        capture->framebuffer_recheck.clear();
+    }
+
+    // Collect the rectangles that need refreshing
+    std::vector<XRectangle> rects;
+    if (damage_available) {
+        bool was_damaged = capture->damaged.exchange(false);
+
+        if (!full_capture && xfixes_available && !was_damaged) {
+            // Only here to re-read last pass's framebuffer rects
+            if (capture->framebuffer_recheck.empty()) {
+                return;
+            }
+        } else if (!full_capture && xfixes_available) {
+            // Pull the accumulated damage region off the server and reset it
+            XDamageSubtract(capture_display, capture->damage, None, damage_parts);
+
+            int num_rects = 0;
+            XRectangle *damage_rects = XFixesFetchRegion(capture_display, damage_parts, &num_rects);
+            for (int i = 0; i < num_rects; i++) {
+                // Clip to the current window bounds
+                int x1 = std::max(0, (int)damage_rects[i].x);
+                int y1 = std::max(0, (int)damage_rects[i].y);
+                int x2 = std::min(width, damage_rects[i].x + damage_rects[i].width);
+                int y2 = std::min(height, damage_rects[i].y + damage_rects[i].height);
+                if (x2 > x1 && y2 > y1) {
+                    add_dirty_rect(rects, {(short)x1, (short)y1, (unsigned short)(x2 - x1), (unsigned short)(y2 - y1)});
+                }
+            }
+            if (damage_rects) XFree(damage_rects);
+
+            if (rects.empty() && capture->framebuffer_recheck.empty()) {
+                return;  // Damage was entirely outside the window
+            }
+        } else if (capture->damage) {
+            XDamageSubtract(capture_display, capture->damage, None, None);
+            full_capture = true;
+        }
+    }
+
+    if (full_capture) {
+        rects.clear();
+        rects.push_back({0, 0, (unsigned short)width, (unsigned short)height});
+
+        // Usually the same buffer, or one from the pool if the size class changed
+        capture->image_data.allocate((size_t)width * height * 4);
+        if (!capture->image_data.data()) {
+            capture->image_width = 0;
+            capture->image_height = 0;
+            return;
+        }
+        capture->image_width = width;
+        capture->image_height = height;
+    }
+
+    if (placement && capture_from_framebuffer(capture, placement, rects, full_capture)) {
+        return;
+    }
+
+    // The window's composite pixmap (off-screen buffer) stays valid until the window
+    // is resized or remapped, so it's only re-named when the main thread says so
+    uint32_t generation = capture->pixmap_generation;
+    if (!capture->pixmap || capture->pixmap_named_generation != generation) {
+        destroy_capture_pixmaps(capture);
+        capture->pixmap = XCompositeNameWindowPixmap(capture_display, capture->xwindow);
+        capture->pixmap_named_generation = generation;
+        pixmap_recreations++;
+    }
+    if (!capture->pixmap) {
+        return;
+    }
+
+    // Low LOD: let the server shrink it so only the small image crosses the wire
+    Pixmap pixmap = capture->pixmap;
+    if (scaled) {
+        pixmap = update_scaled_pixmap(capture, window_width, window_height, width, height);
+        if (!pixmap) {
+            capture->image_width = 0;
+            capture->image_height = 0;
+            return;
+        }
+    }
+
+    // Prefer MIT-SHM: the server writes straight into our persistent segment,
+    // so there's no socket copy and no per-frame XImage allocation.
+    // The segment is only (re)created here on first use or after a resize.
+    bool ok = true;
+    bool captured = false;
+    bool unsupported = false;  // convert_image_rect rejected the pixel format
+    int unsupported_bits = 0;
+    CaptureBackend backend = CAPTURE_BACKEND_XGETIMAGE;
+    if (shm_available && !shm_rejected) {
+        if (!capture->shm_image || capture->shm_image->width != width ||
+            capture->shm_image->height != height) {
+            create_shm_image(capture);
+        }
+
+        if (capture->shm_image) {
+            // One SHM transfer of the damage's bounding box. The segment only stages
+            // pixels for conversion, so a smaller box goes through the sub-image header
+            // and lands packed at the start of the segment.
+            int x1 = width, y1 = height, x2 = 0, y2 = 0;
+            for (const XRectangle &r : rects) {
+                x1 = std::min(x1, (int)r.x);
+                y1 = std::min(y1, (int)r.y);
+                x2 = std::max(x2, r.x + r.width);
+                y2 = std::max(y2, r.y + r.height);
+            }
+
+            XImage *image = capture->shm_image;
+            if (x2 - x1 != width || y2 - y1 != height) {
+                // Same scanline padding XShmCreateImage would use for this width
+                image = capture->shm_sub_image;
+                if (image) {
+                    image->width = x2 - x1;
+                    image->height = y2 - y1;
+                    image->bytes_per_line = (image->width * image->bits_per_pixel + image->bitmap_pad - 1) /
+                                            image->bitmap_pad * (image->bitmap_pad / 8);
+                }
+            }
+
+            captured = image && XShmGetImage(capture_display, pixmap, image, x1, y1, AllPlanes);
+            if (captured) {
+                backend = CAPTURE_BACKEND_SHM;
+                for (const XRectangle &r : rects) {
+                    ok = ok && convert_image_rect(image, capture, r.x - x1, r.y - y1, capture->image_data.data(),
+                                                  width, r.x, r.y, r.width, r.height);
+                }
+                if (!ok) {
+                    unsupported = true;
+                    unsupported_bits = image->bits_per_pixel;
+                }
+            }
+        }
+    }
+
+    // Fall back to a regular XGetImage round trip per dirty rectangle
+    if (!captured) {
+        for (const XRectangle &r : rects) {
+            XImage *image = XGetImage(capture_display, pixmap, r.x, r.y, r.width, r.height, AllPlanes, ZPixmap);
+            if (!image) {
+                ok = false;
+                break;
+            }
+
+            if (!convert_image_rect(image, capture, 0, 0, capture->image_data.data(), width,
+                                    r.x, r.y, r.width, r.height)) {
+                unsupported = true;
+                unsupported_bits = image->bits_per_pixel;
+                ok = false;
+            }
+            XDestroyImage(image);
+
+            if (!ok) {
+                break;
+            }
+        }
+    }
+
+    if (unsupported) {
+        // Retrying would fail the same way on every damage event; say so once and
+        // leave the window alone
+        UtilityFunctions::printerr("Unsupported image format for window 0x", String::num_int64(capture->xwindow, 16),
+                                   ": ", unsupported_bits, " bits per pixel, depth ", capture->depth,
+                                   ", no longer capturing it");
+        capture->unsupported_format = true;
+        return;
+    }
+
+    if (!ok) {
+        // The damage region has already been consumed, so retry with a full capture.
+        // The pixmap may be what failed (e.g. named while the window was unmapped),
+        // so name a fresh one too.
+        destroy_capture_pixmaps(capture);
+        capture->image_width = 0;
+        capture->image_height = 0;
+        return;
+    }
+
+    // Repaints that didn't change anything (paused spinners, clocks between ticks)
+    // end here, so the main thread sees no new frame and uploads nothing
+    if (!drop_unchanged_tiles(capture, rects, &full_capture)) {
+        return;
+    }
+    publish_frame(capture, rects, full_capture, backend);
+}
+
+// Triple buffer bookkeeping: the low bits of WindowCapture::middle hold a frame
+// index, CAPTURE_FRAME_FRESH is set when the capture thread published a frame
+// the main thread hasn't taken yet
+static const uint8_t CAPTURE_FRAME_INDEX_MASK = 0x3;
+static const uint8_t CAPTURE_FRAME_FRESH = 0x4;
+
+// How many recent captures' rects we keep for bringing stale frames up to date
+static const size_t CAPTURE_HISTORY_LENGTH = 4;
+
+static void copy_rect(const uint8_t *src, uint8_t *dst, int width, const XRectangle &rect) {
+    for (int y = rect.y; y < rect.y + rect.height; y++) {
+        size_t offset = ((size_t)y * width + rect.x) * 4;
+        memcpy(dst + offset, src + offset, (size_t)rect.width * 4);
+    }
+}
+
+// Edge length of the squares frames are hashed in to find what actually changed
+static const int CAPTURE_TILE_SIZE = 64;
+
+bool X11Compositor::drop_unchanged_tiles(WindowCapture *capture, std::vector<XRectangle> &rects,
+                                         bool *full_capture) {
+    int width = capture->image_width;
+    int height = capture->image_height;
+    int columns = (width + CAPTURE_TILE_SIZE - 1) / CAPTURE_TILE_SIZE;
+    int rows = (height + CAPTURE_TILE_SIZE - 1) / CAPTURE_TILE_SIZE;
+    size_t stride = (size_t)width * 4;
+    const uint8_t *pixels = capture->image_data.data();
+
+    auto tile_rect = [&](int column, int row) {
+        int x = column * CAPTURE_TILE_SIZE;
+        int y = row * CAPTURE_TILE_SIZE;
+        return XRectangle{(short)x, (short)y, (unsigned short)std::min(CAPTURE_TILE_SIZE, width - x),
+                          (unsigned short)std::min(CAPTURE_TILE_SIZE, height - y)};
+    };
+    auto hash_tile = [&](const XRectangle &r) {
+        return pixel_hash_rect(pixels + (size_t)r.y * stride + (size_t)r.x * 4, stride, r.width, r.height);
+    };
+
+    // Nothing to compare against (first capture, resize, frames released):
+    // hash the whole frame and publish it as captured
+    if (capture->tile_hashes.empty() || capture->tile_hash_width != width || capture->tile_hash_height != height) {
+        capture->tile_hashes.resize((size_t)columns * rows);
+        for (int row = 0; row < rows; row++) {
+            for (int column = 0; column < columns; column++) {
+                capture->tile_hashes[(size_t)row * columns + column] = hash_tile(tile_rect(column, row));
+            }
+        }
+        capture->tile_hash_width = width;
+        capture->tile_hash_height = height;
+        return true;
+    }
+
+    capture->tile_touched.assign((size_t)columns * rows, 0);
+    for (const XRectangle &r : rects) {
+        int x2 = std::min(width, r.x + r.width);
+        int y2 = std::min(height, r.y + r.height);
+        if (r.x >= x2 || r.y >= y2) {
+            continue;
+        }
+        for (int row = r.y / CAPTURE_TILE_SIZE; row <= (y2 - 1) / CAPTURE_TILE_SIZE; row++) {
+            for (int column = r.x / CAPTURE_TILE_SIZE; column <= (x2 - 1) / CAPTURE_TILE_SIZE; column++) {
+                capture->tile_touched[(size_t)row * columns + column] = 1;
+            }
+        }
+    }
+
+    // Rehash the touched tiles; runs of changed tiles in a row become one rect.
+    // (A CRC collision would leave a tile stale until its next real change.)
+    std::vector<XRectangle> changed;
+    uint64_t unchanged = 0;
+    for (int row = 0; row < rows; row++) {
+        int run_start = -1;
+        for (int column = 0; column <= columns; column++) {
+            bool dirty = false;
+            if (column < columns && capture->tile_touched[(size_t)row * columns + column]) {
+                uint32_t hash = hash_tile(tile_rect(column, row));
+                uint32_t &stored = capture->tile_hashes[(size_t)row * columns + column];
+                dirty = hash != stored;
+                unchanged += !dirty;
+                stored = hash;
+            }
+
+            if (dirty && run_start < 0) {
+                run_start = column;
+            } else if (!dirty && run_start >= 0) {
+                XRectangle first = tile_rect(run_start, row);
+                XRectangle last = tile_rect(column - 1, row);
+                add_dirty_rect(changed, {first.x, first.y, (unsigned short)(last.x + last.width - first.x), first.height});
+                run_start = -1;
+            }
+        }
+    }
+    unchanged_tiles += unchanged;
+
+    if (changed.empty()) {
+        unchanged_captures++;
+        return false;
+    }
+
+    // Everything outside the changed tiles is identical to the last published frame
+    rects.swap(changed);
+    *full_capture = false;
+    return true;
+}
+
+void X11Compositor::publish_frame(WindowCapture *capture, const std::vector<XRectangle> &rects,
+                                  bool full_capture, CaptureBackend backend) {
+    capture->sequence++;
+    capture->history.emplace_back(capture->sequence, rects);
+    if (capture->history.size() > CAPTURE_HISTORY_LENGTH) {
+        capture->history.pop_front();
+    }
+
+    // The back frame can hold any older capture. Bring it up to date by copying
+    // every region changed since then, or the whole frame if it's too far behind.
+    CaptureFrame &frame = capture->frames[capture->back];
+    int width = capture->image_width;
+    int height = capture->image_height;
+    bool copy_all = full_capture || frame.width != width || frame.height != height ||
+                    frame.sequence + 1 < capture->history.front().first;
+
+    // A new size keeps the frame's buffer when it's in range, as image_data does
+    if (copy_all) {
+        frame.pixels.allocate(capture->image_data.size());
+        if (!frame.pixels.data()) {
+            // Out of memory: skip this one, and have the next frame replace everything
+            frame.width = frame.height = 0;
+            frame.sequence = 0;
+            add_dirty_rect(capture->carried_rects, {0, 0, (unsigned short)width, (unsigned short)height});
+            return;
+        }
+        memcpy(frame.pixels.data(), capture->image_data.data(), capture->image_data.size());
+    } else {
+        uint8_t *dst = frame.pixels.data();
+        for (const auto &entry : capture->history) {
+            if (entry.first <= frame.sequence) {
+                continue;
+            }
+            for (const XRectangle &r : entry.second) {
+                copy_rect(capture->image_data.data(), dst, width, r);
+            }
+        }
+    }
+
+    frame.width = width;
+    frame.height = height;
+    frame.sequence = capture->sequence;
+    frame.backend = backend;
+    capture->last_backend = backend;
+
+    // Report everything that changed since the last frame the main thread took
+    frame.rects = capture->carried_rects;
+    for (const XRectangle &r : rects) {
+        add_dirty_rect(frame.rects, r);
+    }
+
+    uint8_t previous = capture->middle.exchange(capture->back | CAPTURE_FRAME_FRESH, std::memory_order_acq_rel);
+    capture->back = previous & CAPTURE_FRAME_INDEX_MASK;
+
+    // If the frame we got back was never taken, its changes must ride along with the next one
+    if (previous & CAPTURE_FRAME_FRESH) {
+        capture->carried_rects = capture->frames[capture->back].rects;
+    } else {
+        capture->carried_rects.clear();
+    }
+}
+
+CaptureFrame *X11Compositor::acquire_frame(X11Window *window) {
+    WindowCapture *capture = window->capture.get();
+
+    // Swap in the newest published frame, if there is one
+    if (capture->middle.load(std::memory_order_acquire) & CAPTURE_FRAME_FRESH) {
+        const CaptureFrame &old_frame = capture->frames[capture->front];
+        int old_width = old_frame.width;
+        int old_height = old_frame.height;
+
+        uint8_t previous = capture->middle.exchange(capture->front, std::memory_order_acq_rel);
+        capture->front = previous & CAPTURE_FRAME_INDEX_MASK;
+
+        const CaptureFrame &frame = capture->frames[capture->front];
+        if (frame.width != old_width || frame.height != old_height) {
+            window->updated_rects.clear();  // Old rects don't apply to the new size
+        }
+        for (const XRectangle &r : frame.rects) {
+            add_dirty_rect(window->updated_rects, r);
+        }
+        mark_dirty_tiles(window, frame);
+    }
+
+    // Someone is displaying this window, so the scheduler should favor it
+    // (and bring its frame back if it was parked)
+    capture->last_viewed_frame = frame_counter.load();
+    if (capture->memory_state == FRAME_MEMORY_COMPRESSED) {
+        capture_wanted = true;
+    }
+
+    CaptureFrame *frame = &capture->frames[capture->front];
+    return frame->sequence ? frame : nullptr;
+}
+
+void X11Compositor::request_capture() {
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex);
+        capture_requested = true;
+    }
+    capture_cv.notify_one();
+}
+
+void X11Compositor::start_capture_thread() {
+    capture_running = true;
+    capture_thread = std::thread(&X11Compositor::capture_thread_main, this);
+}
+
+void X11Compositor::stop_capture_thread() {
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex);
+        capture_running = false;
+    }
+    capture_cv.notify_all();
+
+    if (capture_thread.joinable()) {
+        capture_thread.join();
+    }
+}
+
+void X11Compositor::capture_thread_main() {
+    int64_t next_capture_usec = 0;  // Earliest rate-limited capture still owed (0 = none)
+
+    while (true) {
+        std::vector<std::shared_ptr<WindowCapture>> jobs;
+        std::vector<std::shared_ptr<WindowCapture>> retired;
+
+        {
+            std::unique_lock<std::mutex> lock(capture_mutex);
+
+            // With damage tracking we sleep until something changes; without it we poll
+            // at ~60 Hz. The timeout also retries captures that failed, comes back
+            // quickly to confirm framebuffer reads, and never sleeps past the moment
+            // a rate-limited window's deferred damage is due.
+            bool poll = !damage_available || framebuffer_recheck_pending;
+            auto timeout = std::chrono::microseconds(poll ? 16000 : 100000);
+            if (next_capture_usec) {
+                auto until_due = std::chrono::microseconds(std::max<int64_t>(0, next_capture_usec - steady_usec()));
+                timeout = std::min(timeout, until_due);
+            }
+            capture_cv.wait_for(lock, timeout, [this] { return capture_requested || !capture_running; });
+
+            if (!capture_running) {
+                break;
+            }
+            capture_requested = false;
+            jobs = capture_jobs;
+            retired.swap(capture_retired);
+        }
+
+        for (auto &capture : retired) {
+            release_capture_resources(capture.get());
+        }
+
+        // Priority order: focused window, then windows displayed in the last couple of
+        // frames, then everything else. Ties go to whichever waited longest, so deferred
+        // windows can't starve.
+        uint64_t frame = frame_counter.load();
+        X11WindowHandle focused = focused_xwindow.load();
+        std::vector<std::pair<int, WindowCapture*>> queue;
+        queue.reserve(jobs.size());
+        for (auto &capture : jobs) {
+            int priority = 0;
+            if (capture->xwindow == focused) {
+                priority = 2;
+            } else if (frame - capture->last_viewed_frame.load() <= 2) {
+                priority = 1;
+            }
+            queue.emplace_back(priority, capture.get());
+        }
+        std::sort(queue.begin(), queue.end(), [](const std::pair<int, WindowCapture*> &a,
+                                                 const std::pair<int, WindowCapture*> &b) {
+            if (a.first != b.first) {
+                return a.first > b.first;
+            }
+            return a.second->last_capture_pass < b.second->last_capture_pass;
+        });
+
+        capture_pass++;
+        int64_t budget_usec = capture_budget_usec.load();
+        auto start = std::chrono::steady_clock::now();
+        int backlog = 0;
+        bool recheck_pending = false;
+        next_capture_usec = 0;
+
+        for (auto &entry : queue) {
+            WindowCapture *capture = entry.second;
+
+            // Parked frame someone is looking at again
+            if (capture->memory_state == FRAME_MEMORY_COMPRESSED && frame - capture->last_viewed_frame.load() <= 2) {
+                restore_frame(capture, true);
+            }
+
+            if (needs_capture(capture, &next_capture_usec)) {
+                // Out of time: leave the damage accumulated for the next pass
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+                if (budget_usec > 0 && elapsed.count() >= budget_usec) {
+                    backlog++;
+                    continue;
+                }
+
+                capture_window_contents(capture);
+                capture->last_capture_pass = capture_pass;
+                capture->last_capture_usec = steady_usec();
+            }
+
+            update_thumbnail(capture, steady_usec());
+            recheck_pending = recheck_pending || !capture->framebuffer_recheck.empty();
+        }
+
+        capture_backlog = backlog;
+        framebuffer_recheck_pending = recheck_pending;
+
+        enforce_memory_budget(jobs);
+        last_capture_pass_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void X11Compositor::update_memory_accounting(WindowCapture *capture) {
+    uint64_t resident = 0;
+    if (capture->memory_state == FRAME_MEMORY_WARM) {
+        // Latest frame plus the three triple-buffer frames (approximately its size)
+        resident = capture->image_data.capacity() + 3 * capture->image_data.size();
+        if (capture->shm_image) {
+            resident += (uint64_t)capture->shm_image->bytes_per_line * capture->shm_image->height;
+        }
+    }
+    capture->resident_bytes = resident;
+    capture->compressed_bytes = capture->cold_data.capacity();
+}
+
+void X11Compositor::make_cold(WindowCapture *capture, bool drop) {
+    if (drop) {
+        // Forget the contents entirely; the next capture starts from scratch
+        capture->image_width = 0;
+        capture->image_height = 0;
+        capture->cold_data.clear();
+        capture->cold_data.shrink_to_fit();
+    } else if (capture->memory_state == FRAME_MEMORY_WARM) {
+        frame_compress(capture->image_data.data(), capture->image_data.size() / 4, capture->cold_data);
+        capture->cold_data.shrink_to_fit();
+    }
+
+    if (capture->memory_state == FRAME_MEMORY_WARM) {
+        capture->image_data.release();
+        capture->history.clear();
+        capture->tile_hashes.clear();  // The next capture has to be published in full
+
+        // The back frame is ours. The middle one is too, as long as it isn't waiting
+        // to be taken - the main thread only swaps it out when it's marked fresh.
+        CaptureFrame &back = capture->frames[capture->back];
+        back.pixels.release();
+        back.width = back.height = 0;
+        back.sequence = 0;
+        uint8_t middle = capture->middle.load(std::memory_order_acquire);
+        if (!(middle & CAPTURE_FRAME_FRESH)) {
+            CaptureFrame &idle = capture->frames[middle & CAPTURE_FRAME_INDEX_MASK];
+            idle.pixels.release();
+            idle.width = idle.height = 0;
+        }
+
+        destroy_shm_image(capture);
+    }
+
+    capture->memory_state = drop ? FRAME_MEMORY_DROPPED : FRAME_MEMORY_COMPRESSED;
+    update_memory_accounting(capture);
+}
+
+void X11Compositor::restore_frame(WindowCapture *capture, bool publish) {
+    if (capture->memory_state == FRAME_MEMORY_COMPRESSED) {
+        capture->image_data.allocate((size_t)capture->image_width * capture->image_height * 4);
+        if (!capture->image_data.data() || !frame_decompress(capture->cold_data.data(), capture->cold_data.size(),
+                              capture->image_data.data(), capture->image_data.size() / 4)) {
+            capture->image_width = 0;  // Recapture instead
+            capture->image_height = 0;
+        }
+    }
+    capture->cold_data.clear();
+    capture->cold_data.shrink_to_fit();
+    capture->memory_state = FRAME_MEMORY_WARM;
+
+    // Hand the main thread its frame back even if the window hasn't changed since
+    if (publish && capture->image_width > 0) {
+        std::vector<XRectangle> rects = {{0, 0, (unsigned short)capture->image_width, (unsigned short)capture->image_height}};
+        publish_frame(capture, rects, true, capture->last_backend);
+    }
+    update_memory_accounting(capture);
+}
+
+void X11Compositor::enforce_memory_budget(const std::vector<std::shared_ptr<WindowCapture>> &captures) {
+    uint64_t total = 0;
+    for (auto &capture : captures) {
+        update_memory_accounting(capture.get());
+        total += capture->resident_bytes + capture->compressed_bytes;
+    }
+
+    int64_t budget = frame_memory_budget;
+    if (budget <= 0 || total <= (uint64_t)budget) {
+        return;
+    }
+
+    // Least recently viewed first
+    uint64_t frame = frame_counter;
+    std::vector<WindowCapture*> cold;
+    for (auto &capture : captures) {
+        if (frame - capture->last_viewed_frame.load() > COLD_FRAME_AGE) {
+            cold.push_back(capture.get());
+        }
+    }
+    std::sort(cold.begin(), cold.end(), [](WindowCapture *a, WindowCapture *b) {
+        return a->last_viewed_frame.load() < b->last_viewed_frame.load();
+    });
+
+    // Compress, then - if that wasn't enough - drop windows nobody can see anyway
+    for (int pass = 0; pass < 2 && total > (uint64_t)budget; pass++) {
+        bool drop = pass == 1;
+        for (WindowCapture *capture : cold) {
+            if (total <= (uint64_t)budget) {
+                break;
+            }
+
+            int state = capture->memory_state;
+            bool invisible = !capture->mapped || capture->interest == WINDOW_INTEREST_HIDDEN;
+            if ((!drop && state != FRAME_MEMORY_WARM) || (drop && (state == FRAME_MEMORY_DROPPED || !invisible)) ||
+                capture->image_width <= 0) {
+                continue;
+            }
+
+            uint64_t before = capture->resident_bytes + capture->compressed_bytes;
+            make_cold(capture, drop);
+            total = total - before + capture->resident_bytes + capture->compressed_bytes;
+        }
+    }
+}
+
+void X11Compositor::release_cold_frames() {
+    for (auto &pair : windows) {
+        X11Window *window = pair.second;
+        WindowCapture *capture = window->capture.get();
+        if (capture->memory_state == FRAME_MEMORY_WARM) {
+            continue;
+        }
+
+        // Nothing fresh is coming for a parked window, so the front frame and the
+        // image copied from it are the last copies; drop them until it's restored
+        CaptureFrame &front = capture->frames[capture->front];
+        if (front.sequence && !(capture->middle.load(std::memory_order_acquire) & CAPTURE_FRAME_FRESH)) {
+            window->image.unref();
+            window->image_sequence = 0;
+            front.pixels.release();
+            front.width = front.height = 0;
+            front.sequence = 0;
+        }
+    }
+}
+
+TypedArray<int> X11Compositor::get_window_ids() {
+    // Hash table order is arbitrary; keep returning IDs in creation order
+    std::vector<int> sorted_ids;
+    sorted_ids.reserve(windows.size());
+    for (const auto &pair : windows) {
+        sorted_ids.push_back(pair.first);
+    }
+    std::sort(sorted_ids.begin(), sorted_ids.end());
+
+    TypedArray<int> ids;
+    for (int id : sorted_ids) {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+int64_t X11Compositor::get_window_generation() const {
+    return (int64_t)window_generation;
+}
+
+// Bumped when get_window_snapshot()'s layout changes
+static const int WINDOW_SNAPSHOT_VERSION = 1;
+
+Dictionary X11Compositor::get_window_snapshot() {
+    if (window_snapshot_generation == window_generation) {
+        return window_snapshot;
+    }
+
+    // Same order as get_window_ids()
+    std::vector<int> sorted_ids;
+    sorted_ids.reserve(windows.size());
+    for (const auto &pair : windows) {
+        sorted_ids.push_back(pair.first);
+    }
+    std::sort(sorted_ids.begin(), sorted_ids.end());
+
+    // One packed array per field, indexed like "ids"
+    PackedInt32Array ids;
+    PackedInt32Array parents;
+    PackedInt32Array pids;
+    PackedInt32Array rects;  // Root x, y, width, height per window
+    PackedInt32Array flags;  // WindowSnapshotFlags
+    PackedStringArray titles;
+    PackedStringArray classes;
+    for (int id : sorted_ids) {
+        X11Window *window = windows[id];
+        ids.push_back(id);
+        parents.push_back(window->parent_window_id);
+        pids.push_back(window->pid);
+        Vector2i position = window_root_position(window);
+        rects.push_back(position.x);
+        rects.push_back(position.y);
+        rects.push_back(window->width);
+        rects.push_back(window->height);
+        flags.push_back((window->mapped ? WINDOW_SNAPSHOT_MAPPED : 0) |
+                        (window->is_dialog ? WINDOW_SNAPSHOT_DIALOG : 0) |
+                        (window->capture->has_alpha ? WINDOW_SNAPSHOT_TRANSPARENT : 0));
+        titles.push_back(window->wm_name);
+        classes.push_back(window->wm_class);
+    }
+
+    // A new Dictionary each time, so a snapshot a script kept never changes under it
+    Dictionary snapshot;
+    snapshot["version"] = WINDOW_SNAPSHOT_VERSION;
+    snapshot["generation"] = (int64_t)window_generation;
+    snapshot["ids"] = ids;
+    snapshot["parents"] = parents;
+    snapshot["pids"] = pids;
+    snapshot["rects"] = rects;
+    snapshot["flags"] = flags;
+    snapshot["titles"] = titles;
+    snapshot["classes"] = classes;
+
+    window_snapshot = snapshot;
+    window_snapshot_generation = window_generation;
+    return window_snapshot;
+}
+
+Ref<Image> X11Compositor::get_window_buffer(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return Ref<Image>();
+    }
+
+    X11Window *window = it->second;
+    WindowCapture *capture = window->capture.get();
+    uint64_t shown_sequence = capture->frames[capture->front].sequence;
+
+    // Never blocks: takes the newest frame the capture thread finished, if any
+    CaptureFrame *frame = acquire_frame(window);
+    if (!frame || frame->pixels.empty()) {
+        return Ref<Image>();
+    }
+
+    if (frame->width <= 0 || frame->height <= 0) {
+        return Ref<Image>();
+    }
+
+    // Unchanged window: hand back the same image, no allocation or copy
+    if (window->image.is_valid() && window->image_sequence == frame->sequence) {
+        return window->image;
+    }
+
+    // If the image still shows the frame this one replaced, only the regions the
+    // frame reports changed need copying. Anything else gets a new image buffer -
+    // the one allocation left on this path, and only when the size changes.
+    if (window->image.is_valid() && window->image_sequence == shown_sequence &&
+        window->image->get_width() == frame->width && window->image->get_height() == frame->height) {
+        uint8_t *dst = window->image->ptrw();
+        for (const XRectangle &r : frame->rects) {
+            copy_rect(frame->pixels.data(), dst, frame->width, r);
+        }
+    } else {
+        PackedByteArray pixels;
+        pixels.resize((int64_t)frame->pixels.size());
+        memcpy(pixels.ptrw(), frame->pixels.data(), frame->pixels.size());
+        if (window->image.is_null()) {
+            window->image = Image::create_from_data(frame->width, frame->height,
+                                                    false, Image::FORMAT_RGBA8, pixels);
+        } else {
+            window->image->set_data(frame->width, frame->height, false, Image::FORMAT_RGBA8, pixels);
+        }
+    }
+    window->image_sequence = frame->sequence;
+
+    return window->image;
+}
+
+Ref<Texture2D> X11Compositor::get_window_texture(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return Ref<Texture2D>();
+    }
+
+    X11Window *window = it->second;
+
+    // Pull in the newest frame (updates window->image in place)
+    Ref<Image> image = get_window_buffer(window_id);
+
+    // With a RenderingDevice (Forward+/Mobile) only the changed tiles are uploaded
+    RenderingDevice *rd = RenderingServer::get_singleton()->get_rendering_device();
+    if (rd) {
+        if (image.is_null()) {
+            return window->tiled_texture;
+        }
+        return update_tiled_texture(window, image, rd);
+    }
+
+    if (image.is_null()) {
+        return window->texture;
+    }
+
+    // Only upload when the window actually changed
+    if (window->texture.is_valid() && window->texture_sequence == window->image_sequence) {
+        return window->texture;
+    }
+
+    if (window->texture.is_null()) {
+        window->texture = ImageTexture::create_from_image(image);
+    } else if (window->texture->get_width() != image->get_width() ||
+               window->texture->get_height() != image->get_height()) {
+        // New size needs a new GPU texture, but keep the same ImageTexture
+        // so scripts holding it see the change
+        window->texture->set_image(image);
+    } else {
+        // Same size: update the existing GPU texture in place
+        window->texture->update(image);
+    }
+    window->texture_sequence = window->image_sequence;
+    texture_full_uploads++;
+    texture_upload_bytes += (uint64_t)image->get_width() * image->get_height() * 4;
+
+    return window->texture;
+}
+
+// Edge length of the tiles window textures are updated in
+static const int TEXTURE_TILE_SIZE = 64;
+
+void X11Compositor::mark_dirty_tiles(X11Window *window, const CaptureFrame &frame) {
+    int columns = (frame.width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    int rows = (frame.height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+
+    // New size: the texture gets recreated, so everything counts as dirty
+    if (columns != window->tile_columns || rows != window->tile_rows) {
+        window->dirty_tiles.assign((size_t)columns * rows, 1);
+        window->tile_columns = columns;
+        window->tile_rows = rows;
+        return;
+    }
+
+    for (const XRectangle &r : frame.rects) {
+        int x2 = std::min(frame.width, r.x + r.width);
+        int y2 = std::min(frame.height, r.y + r.height);
+        if (r.x >= x2 || r.y >= y2) {
+            continue;
+        }
+        for (int row = r.y / TEXTURE_TILE_SIZE; row <= (y2 - 1) / TEXTURE_TILE_SIZE; row++) {
+            for (int column = r.x / TEXTURE_TILE_SIZE; column <= (x2 - 1) / TEXTURE_TILE_SIZE; column++) {
+                window->dirty_tiles[(size_t)row * columns + column] = 1;
+            }
+        }
+    }
+}
+
+static RID create_rgba_texture(RenderingDevice *rd, int width, int height, const PackedByteArray &pixels) {
+    Ref<RDTextureFormat> format;
+    format.instantiate();
+    format->set_format(RenderingDevice::DATA_FORMAT_R8G8B8A8_UNORM);
+    format->set_width(width);
+    format->set_height(height);
+    format->set_usage_bits(RenderingDevice::TEXTURE_USAGE_SAMPLING_BIT | RenderingDevice::TEXTURE_USAGE_CAN_UPDATE_BIT |
+                           RenderingDevice::TEXTURE_USAGE_CAN_COPY_FROM_BIT | RenderingDevice::TEXTURE_USAGE_CAN_COPY_TO_BIT);
+    // Same formats ImageTexture uses, so materials get their sRGB view as usual
+    format->add_shareable_format(RenderingDevice::DATA_FORMAT_R8G8B8A8_UNORM);
+    format->add_shareable_format(RenderingDevice::DATA_FORMAT_R8G8B8A8_SRGB);
+
+    Ref<RDTextureView> view;
+    view.instantiate();
+
+    TypedArray<PackedByteArray> data;
+    data.push_back(pixels);
+    return rd->texture_create(format, view, data);
+}
+
+Ref<Texture2D> X11Compositor::update_tiled_texture(X11Window *window, const Ref<Image> &image, RenderingDevice *rd) {
+    // Only upload when the window actually changed
+    if (window->tiled_texture.is_valid() && window->texture_sequence == window->image_sequence) {
+        return window->tiled_texture;
+    }
+
+    int width = image->get_width();
+    int height = image->get_height();
+    PackedByteArray pixels = image->get_data();  // Shared, not copied
+
+    if (!window->texture_rid.is_valid() || width != window->texture_width || height != window->texture_height) {
+        // New size needs a new GPU texture, but keep the same Texture2DRD
+        // so scripts holding it see the change
+        RID rid = create_rgba_texture(rd, width, height, pixels);
+        if (!rid.is_valid()) {
+            return window->tiled_texture;
+        }
+        if (window->tiled_texture.is_null()) {
+            window->tiled_texture.instantiate();
+        }
+        window->tiled_texture->set_texture_rd_rid(rid);
+        if (window->texture_rid.is_valid()) {
+            rd->free_rid(window->texture_rid);
+        }
+        window->texture_rid = rid;
+        window->texture_width = width;
+        window->texture_height = height;
+
+        if (!window->staging_rid.is_valid()) {
+            PackedByteArray blank;
+            blank.resize((int64_t)TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * 4);
+            window->staging_rid = create_rgba_texture(rd, TEXTURE_TILE_SIZE, TEXTURE_TILE_SIZE, blank);
+        }
+
+        std::fill(window->dirty_tiles.begin(), window->dirty_tiles.end(), 0);
+        texture_full_uploads++;
+        texture_upload_bytes += pixels.size();
+        window->texture_sequence = window->image_sequence;
+        return window->tiled_texture;
+    }
+
+    size_t dirty = std::count(window->dirty_tiles.begin(), window->dirty_tiles.end(), 1);
+    if (dirty * 2 >= window->dirty_tiles.size() || !window->staging_rid.is_valid() ||
+        window->dirty_tiles.size() != (size_t)window->tile_columns * window->tile_rows) {
+        // Mostly dirty - one whole-texture upload beats many small ones
+        rd->texture_update(window->texture_rid, 0, pixels);
+        texture_full_uploads++;
+        texture_upload_bytes += pixels.size();
+    } else {
+        // Each dirty tile goes through the staging texture and is copied into place
+        PackedByteArray tile;
+        tile.resize((int64_t)TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * 4);
+        const uint8_t *src = pixels.ptr();
+        size_t stride = (size_t)width * 4;
+        for (int row = 0; row < window->tile_rows; row++) {
+            for (int column = 0; column < window->tile_columns; column++) {
+                if (!window->dirty_tiles[(size_t)row * window->tile_columns + column]) {
+                    continue;
+                }
+
+                int x = column * TEXTURE_TILE_SIZE;
+                int y = row * TEXTURE_TILE_SIZE;
+                int tile_width = std::min(TEXTURE_TILE_SIZE, width - x);
+                int tile_height = std::min(TEXTURE_TILE_SIZE, height - y);
+                uint8_t *dst = tile.ptrw();
+                for (int ty = 0; ty < tile_height; ty++) {
+                    memcpy(dst + (size_t)ty * TEXTURE_TILE_SIZE * 4, src + (size_t)(y + ty) * stride + (size_t)x * 4,
+                           (size_t)tile_width * 4);
+                }
+
+                rd->texture_update(window->staging_rid, 0, tile);
+                rd->texture_copy(window->staging_rid, window->texture_rid, Vector3(0, 0, 0), Vector3(x, y, 0),
+                                 Vector3(tile_width, tile_height, 1), 0, 0, 0, 0);
+                texture_tile_uploads++;
+                texture_upload_bytes += tile.size();
+            }
+        }
+    }
+
+    std::fill(window->dirty_tiles.begin(), window->dirty_tiles.end(), 0);
+    window->texture_sequence = window->image_sequence;
+    return window->tiled_texture;
+}
+
+void X11Compositor::free_window_textures(X11Window *window) {
+    // The rendering server may already be gone when we're torn down at exit
+    RenderingServer *rs = RenderingServer::get_singleton();
+    RenderingDevice *rd = rs ? rs->get_rendering_device() : nullptr;
+    if (!rd) {
+        return;
+    }
+
+    // Detach first so nothing samples a freed texture
+    if (window->tiled_texture.is_valid()) {
+        window->tiled_texture->set_texture_rd_rid(RID());
+    }
+    if (window->texture_rid.is_valid()) {
+        rd->free_rid(window->texture_rid);
+        window->texture_rid = RID();
+    }
+    if (window->staging_rid.is_valid()) {
+        rd->free_rid(window->staging_rid);
+        window->staging_rid = RID();
+    }
+}
+
+Ref<Texture2D> X11Compositor::get_window_thumbnail(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return Ref<Texture2D>();
+    }
+
+    X11Window *window = it->second;
+    WindowCapture *capture = window->capture.get();
+
+    // Keep the capture thread producing thumbnails for this window; on a fresh
+    // request, wake it so the first one doesn't wait for damage
+    uint64_t frame = frame_counter;
+    uint64_t previous = capture->thumbnail_request_frame.exchange(frame + 1);
+    if (previous == 0 || frame + 1 - previous > THUMBNAIL_REQUEST_FRAMES) {
+        capture_wanted = true;
+    }
+
+    PackedByteArray pixels;
+    int width, height;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(capture->thumbnail_mutex);
+        sequence = capture->thumbnail_sequence;
+        if (sequence == 0 || sequence == window->thumbnail_sequence) {
+            return window->thumbnail;
+        }
+        pixels = capture->thumbnail_pixels;
+        width = capture->thumbnail_width;
+        height = capture->thumbnail_height;
+    }
+
+    Ref<Image> image = Image::create_from_data(width, height, false, Image::FORMAT_RGBA8, pixels);
+    if (window->thumbnail.is_null()) {
+        window->thumbnail = ImageTexture::create_from_image(image);
+    } else if (window->thumbnail->get_width() != width || window->thumbnail->get_height() != height) {
+        window->thumbnail->set_image(image);
+    } else {
+        window->thumbnail->update(image);
+    }
+    window->thumbnail_sequence = sequence;
+
+    return window->thumbnail;
+}
+
+Vector2i X11Compositor::get_window_size(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return Vector2i(0, 0);
+    }
+
+    X11Window *window = it->second;
+    return Vector2i(window->width, window->height);
+}
+
+String X11Compositor::get_display_name() {
     if (!initialized || display_number == 0) {
         return String();
     }
@@ -793,25 +2776,7 @@ Vector2i X11Compositor::get_window_position(int window_id) {
     if (it == windows.end()) {
         return Vector2i(0, 0);
     }
-    X11Window *window = it->second;
-
-    // Can't get position of unmapped windows (causes BadWindow error)
-    if (!window->mapped) {
-        return Vector2i(window->x, window->y);  // Return cached position
-    }
-
-    // Get absolute position relative to root window using XTranslateCoordinates
-    // This is more reliable than XWindowAttributes x,y which can be relative to parent
-    ::Window child_return;
-    int x_return, y_return;
-
-    XTranslateCoordinates(display, window->xwindow, root_window,
-                         0, 0, &x_return, &y_return, &child_return);
-
-    UtilityFunctions::print("Window ", window_id, " position: attrs=(", window->x, ",", window->y,
-                           ") absolute=(", x_return, ",", y_return, ")");
-
-    return Vector2i(x_return, y_return);
+    return window_root_position(it->second);
 }
 
 bool X11Compositor::is_window_mapped(int window_id) {
@@ -830,6 +2795,52 @@ bool X11Compositor::is_window_dialog(int window_id) {
     return it->second->is_dialog;
 }
 
+bool X11Compositor::is_window_transparent(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return false;  // Window doesn't exist
+    }
+    return it->second->capture->has_alpha;
+}
+
+TypedArray<Rect2i> X11Compositor::get_window_dirty_rects(int window_id) {
+    TypedArray<Rect2i> rects;
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return rects;
+    }
+
+    // Return the regions refreshed in frames handed out by get_window_buffer
+    // since the last call, then reset
+    X11Window *window = it->second;
+    for (const XRectangle &r : window->updated_rects) {
+        rects.push_back(Rect2i(r.x, r.y, r.width, r.height));
+    }
+    window->updated_rects.clear();
+    return rects;
+}
+
+String X11Compositor::get_window_capture_backend(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return String();
+    }
+    // Report on the frame the main thread currently holds
+    WindowCapture *capture = it->second->capture.get();
+    const CaptureFrame &frame = capture->frames[capture->front];
+    if (!frame.sequence) {
+        return String("none");  // Nothing captured yet
+    }
+    switch (frame.backend) {
+        case CAPTURE_BACKEND_SHM:
+            return String("shm");
+        case CAPTURE_BACKEND_FRAMEBUFFER:
+            return String("framebuffer");
+        default:
+            return String("xgetimage");
+    }
+}
+
 // Input handling methods
 void X11Compositor::send_mouse_button(int window_id, int button, bool pressed, int x, int y) {
     auto it = windows.find(window_id);
@@ -838,51 +2849,23 @@ void X11Compositor::send_mouse_button(int window_id, int button, bool pressed, i
     }
 
     X11Window *window = it->second;
-
-    // Get window's absolute position on the X11 screen
-    ::Window child_return;
-    int win_x_root, win_y_root;
-    XTranslateCoordinates(display, window->xwindow, root_window,
-                         0, 0, &win_x_root, &win_y_root, &child_return);
-
-    int root_x = win_x_root + x;
-    int root_y = win_y_root + y;
-
-    UtilityFunctions::print("[X11] Mouse button ", pressed ? "PRESS" : "RELEASE", " to window ", window_id,
-                           " (parent:", window->parent_window_id, ")",
-                           " - window_pos=(", x, ",", y, ")",
-                           " win_absolute=(", win_x_root, ",", win_y_root, ")",
-                           " root_coords=(", root_x, ",", root_y, ")",
-                           " using ", xtest_available ? "XTest" : "XSendEvent");
-
-    if (xtest_available) {
-        // Use XTest extension for realistic events (bypasses synthetic event detection)
-        // First move the pointer to the correct position
-        XTestFakeMotionEvent(display, screen, root_x, root_y, CurrentTime);
-        // Then send the button event
-        XTestFakeButtonEvent(display, button, pressed ? True : False, CurrentTime);
-        XFlush(display);
-    } else {
-        // Fallback to XSendEvent (may be ignored by some apps like Firefox popups)
-        XEvent event;
-        memset(&event, 0, sizeof(event));
-
-        event.type = pressed ? ButtonPress : ButtonRelease;
-        event.xbutton.window = window->xwindow;
-        event.xbutton.root = root_window;
-        event.xbutton.subwindow = None;
-        event.xbutton.time = CurrentTime;
-        event.xbutton.x = x;
-        event.xbutton.y = y;
-        event.xbutton.x_root = root_x;
-        event.xbutton.y_root = root_y;
-        event.xbutton.state = 0;
-        event.xbutton.button = button;
-        event.xbutton.same_screen = True;
-
-        XSendEvent(display, window->xwindow, True, ButtonPressMask | ButtonReleaseMask, &event);
-        XFlush(display);
-    }
+    Vector2i origin = window_root_position(window);
+
+    QueuedInput input;
+    input.type = QUEUED_INPUT_BUTTON;
+    input.xwindow = window->xwindow;
+    input.x = x;
+    input.y = y;
+    input.root_x = origin.x + x;
+    input.root_y = origin.y + y;
+    input.detail = button;
+    input.state = 0;
+    input.pressed = pressed;
+
+    // Clicks go out right away, after the motion queued before them
+    input_events_received++;
+    queue_input(input);
+    flush_input();
 }
 
 void X11Compositor::send_mouse_motion(int window_id, int x, int y) {
@@ -892,41 +2875,132 @@ void X11Compositor::send_mouse_motion(int window_id, int x, int y) {
     }
 
     X11Window *window = it->second;
+    Vector2i origin = window_root_position(window);
+
+    QueuedInput input;
+    input.type = QUEUED_INPUT_MOTION;
+    input.xwindow = window->xwindow;
+    input.x = x;
+    input.y = y;
+    input.root_x = origin.x + x;
+    input.root_y = origin.y + y;
+    input.detail = 0;
+    input.state = 0;
+    input.pressed = false;
+    input_events_received++;
+    queue_input(input);
+
+    // Normally _process sends it; this covers frames long enough to miss the latency target
+    if (input_latency_usec > 0 && steady_usec() - input_queued_usec >= input_latency_usec) {
+        flush_input();
+    }
+}
 
-    // Get window's absolute position on the X11 screen
-    ::Window child_return;
-    int win_x_root, win_y_root;
-    XTranslateCoordinates(display, window->xwindow, root_window,
-                         0, 0, &win_x_root, &win_y_root, &child_return);
+void X11Compositor::queue_input(const QueuedInput &input) {
+    if (input_queue.empty()) {
+        input_queued_usec = steady_usec();
+    }
 
-    int root_x = win_x_root + x;
-    int root_y = win_y_root + y;
+    // Only the latest pointer position matters, and a drag reports many per frame
+    if (input.type == QUEUED_INPUT_MOTION && !input_queue.empty()) {
+        QueuedInput &last = input_queue.back();
+        if (last.type == QUEUED_INPUT_MOTION && last.xwindow == input.xwindow) {
+            last = input;
+            input_motion_coalesced++;
+            return;
+        }
+    }
+    input_queue.push_back(input);
+}
 
+void X11Compositor::send_input(const QueuedInput &input) {
     if (xtest_available) {
-        // Use XTest extension for realistic mouse motion
-        XTestFakeMotionEvent(display, screen, root_x, root_y, CurrentTime);
-        XFlush(display);
-    } else {
-        // Fallback to XSendEvent
-        XEvent event;
-        memset(&event, 0, sizeof(event));
-
-        event.type = MotionNotify;
-        event.xmotion.window = window->xwindow;
-        event.xmotion.root = root_window;
-        event.xmotion.subwindow = None;
-        event.xmotion.time = CurrentTime;
-        event.xmotion.x = x;
-        event.xmotion.y = y;
-        event.xmotion.x_root = root_x;
-        event.xmotion.y_root = root_y;
-        event.xmotion.state = 0;
-        event.xmotion.is_hint = NotifyNormal;
-        event.xmotion.same_screen = True;
-
-        XSendEvent(display, window->xwindow, True, PointerMotionMask, &event);
-        XFlush(display);
+        // XTest events look real to clients (some, like Firefox popups and
+        // terminals, ignore XSendEvent's synthetic ones)
+        switch (input.type) {
+            case QUEUED_INPUT_MOTION:
+                XTestFakeMotionEvent(display, screen, input.root_x, input.root_y, CurrentTime);
+                input_events_sent++;
+                break;
+            case QUEUED_INPUT_BUTTON:
+                // Move the pointer to where the click is first
+                XTestFakeMotionEvent(display, screen, input.root_x, input.root_y, CurrentTime);
+                XTestFakeButtonEvent(display, input.detail, input.pressed ? True : False, CurrentTime);
+                input_events_sent += 2;
+                break;
+            case QUEUED_INPUT_KEY:
+                XTestFakeKeyEvent(display, input.detail, input.pressed ? True : False, CurrentTime);
+                input_events_sent++;
+                break;
+        }
+        return;
+    }
+
+    // Fallback to XSendEvent
+    XEvent event;
+    memset(&event, 0, sizeof(event));
+    long mask = 0;
+    switch (input.type) {
+        case QUEUED_INPUT_MOTION:
+            event.type = MotionNotify;
+            event.xmotion.window = input.xwindow;
+            event.xmotion.root = root_window;
+            event.xmotion.subwindow = None;
+            event.xmotion.time = CurrentTime;
+            event.xmotion.x = input.x;
+            event.xmotion.y = input.y;
+            event.xmotion.x_root = input.root_x;
+            event.xmotion.y_root = input.root_y;
+            event.xmotion.state = 0;
+            event.xmotion.is_hint = NotifyNormal;
+            event.xmotion.same_screen = True;
+            mask = PointerMotionMask;
+            break;
+        case QUEUED_INPUT_BUTTON:
+            event.type = input.pressed ? ButtonPress : ButtonRelease;
+            event.xbutton.window = input.xwindow;
+            event.xbutton.root = root_window;
+            event.xbutton.subwindow = None;
+            event.xbutton.time = CurrentTime;
+            event.xbutton.x = input.x;
+            event.xbutton.y = input.y;
+            event.xbutton.x_root = input.root_x;
+            event.xbutton.y_root = input.root_y;
+            event.xbutton.state = 0;
+            event.xbutton.button = input.detail;
+            event.xbutton.same_screen = True;
+            mask = ButtonPressMask | ButtonReleaseMask;
+            break;
+        case QUEUED_INPUT_KEY:
+            event.type = input.pressed ? KeyPress : KeyRelease;
+            event.xkey.window = input.xwindow;
+            event.xkey.root = root_window;
+            event.xkey.subwindow = None;
+            event.xkey.time = CurrentTime;
+            event.xkey.x = 0;
+            event.xkey.y = 0;
+            event.xkey.x_root = 0;
+            event.xkey.y_root = 0;
+            event.xkey.state = input.state;  // Include modifier state
+            event.xkey.keycode = input.detail;
+            event.xkey.same_screen = True;
+            mask = KeyPressMask | KeyReleaseMask;
+            break;
+    }
+    XSendEvent(display, input.xwindow, True, mask, &event);
+    input_events_sent++;
+}
+
+void X11Compositor::flush_input() {
+    if (input_queue.empty()) {
+        return;
     }
+    for (const QueuedInput &input : input_queue) {
+        send_input(input);
+    }
+    input_queue.clear();
+    input_flushes++;
+    XFlush(display);  // One flush for the whole batch
 }
 
 void X11Compositor::send_key_event(int window_id, int godot_keycode, bool pressed) {
@@ -937,131 +3011,51 @@ void X11Compositor::send_key_event(int window_id, int godot_keycode, bool presse
 
     X11Window *window = it->second;
 
-    // Map Godot keycodes to X11 keysyms
-    // Godot KEY_* constants don't always match X11 keysyms
-    KeySym keysym;
-
-    // Special key mappings (Godot 4 KEY_* to X11 XK_*)
-    // Godot 4 uses 0x400000 range for special keys
-    switch (godot_keycode) {
-        // Common special keys (Godot 4)
-        case 4194309: keysym = XK_Return; break;         // KEY_ENTER (0x400005)
-        case 4194308: keysym = XK_BackSpace; break;      // KEY_BACKSPACE (0x400004)
-        case 4194305: keysym = XK_Escape; break;         // KEY_ESCAPE (0x400001)
-        case 4194306: keysym = XK_Tab; break;            // KEY_TAB (0x400002)
-        case 32: keysym = XK_space; break;               // KEY_SPACE (ASCII)
-
-        // Arrow keys (Godot 4)
-        case 4194319: keysym = XK_Left; break;           // KEY_LEFT (0x40000F)
-        case 4194320: keysym = XK_Up; break;             // KEY_UP (0x400010)
-        case 4194321: keysym = XK_Right; break;          // KEY_RIGHT (0x400011)
-        case 4194322: keysym = XK_Down; break;           // KEY_DOWN (0x400012)
-
-        // Modifiers (Godot 4)
-        case 4194325: keysym = XK_Shift_L; break;        // KEY_SHIFT (0x400015)
-        case 4194326: keysym = XK_Control_L; break;      // KEY_CTRL (0x400016)
-        case 4194328: keysym = XK_Alt_L; break;          // KEY_ALT (0x400018)
-        case 4194327: keysym = XK_Meta_L; break;         // KEY_META (0x400017)
-
-        // Function keys (Godot 4)
-        case 4194332: keysym = XK_F1; break;             // KEY_F1 (0x40001C)
-        case 4194333: keysym = XK_F2; break;
-        case 4194334: keysym = XK_F3; break;
-        case 4194335: keysym = XK_F4; break;
-        case 4194336: keysym = XK_F5; break;
-        case 4194337: keysym = XK_F6; break;
-        case 4194338: keysym = XK_F7; break;
-        case 4194339: keysym = XK_F8; break;
-        case 4194340: keysym = XK_F9; break;
-        case 4194341: keysym = XK_F10; break;
-        case 4194342: keysym = XK_F11; break;
-        case 4194343: keysym = XK_F12; break;
-
-        // Delete/Insert/Home/End/PageUp/PageDown (Godot 4)
-        case 4194312: keysym = XK_Delete; break;         // KEY_DELETE (0x400008)
-        case 4194311: keysym = XK_Insert; break;         // KEY_INSERT (0x400007)
-        case 4194313: keysym = XK_Home; break;           // KEY_HOME (0x400009)
-        case 4194314: keysym = XK_End; break;            // KEY_END (0x40000A)
-        case 4194315: keysym = XK_Page_Up; break;        // KEY_PAGEUP (0x40000B)
-        case 4194316: keysym = XK_Page_Down; break;      // KEY_PAGEDOWN (0x40000C)
-
-        // Keypad keys (Godot 4)
-        case 4194438: keysym = XK_KP_0; break;           // KEY_KP_0 (0x400086)
-        case 4194439: keysym = XK_KP_1; break;           // KEY_KP_1 (0x400087)
-        case 4194440: keysym = XK_KP_2; break;           // KEY_KP_2 (0x400088)
-        case 4194441: keysym = XK_KP_3; break;           // KEY_KP_3 (0x400089)
-        case 4194442: keysym = XK_KP_4; break;           // KEY_KP_4 (0x40008A)
-        case 4194443: keysym = XK_KP_5; break;           // KEY_KP_5 (0x40008B)
-        case 4194444: keysym = XK_KP_6; break;           // KEY_KP_6 (0x40008C)
-        case 4194445: keysym = XK_KP_7; break;           // KEY_KP_7 (0x40008D)
-        case 4194446: keysym = XK_KP_8; break;           // KEY_KP_8 (0x40008E)
-        case 4194447: keysym = XK_KP_9; break;           // KEY_KP_9 (0x40008F)
-        case 4194433: keysym = XK_KP_Multiply; break;    // KEY_KP_MULTIPLY (0x400081)
-        case 4194434: keysym = XK_KP_Divide; break;      // KEY_KP_DIVIDE (0x400082)
-        case 4194435: keysym = XK_KP_Subtract; break;    // KEY_KP_SUBTRACT (0x400083)
-        case 4194436: keysym = XK_KP_Decimal; break;     // KEY_KP_PERIOD (0x400084)
-        case 4194437: keysym = XK_KP_Add; break;         // KEY_KP_ADD (0x400085)
-        case 4194310: keysym = XK_KP_Enter; break;       // KEY_KP_ENTER (0x400006)
-
-        default:
-            // For printable characters, Godot uses Unicode values which match ASCII for basic chars
-            // Try using the keycode directly as a keysym
-            keysym = godot_keycode;
-            break;
-    }
-
-    // Convert keysym to keycode for this display
-    KeyCode x11_keycode = XKeysymToKeycode(display, keysym);
-
-    if (x11_keycode == 0) {
-        // Keycode not found - might be an unmapped key
-        UtilityFunctions::print("Warning: Cannot map Godot keycode 0x", String::num_int64(godot_keycode, 16), " (keysym 0x", String::num_int64(keysym, 16), ") to X11 keycode");
+    KeyCode x11_keycode;
+    unsigned int needed_modifiers;
+    if (!key_map.lookup(godot_keycode, &x11_keycode, &needed_modifiers)) {
+        // Not a key this keyboard has (or outside the special-key and Latin-1 range)
+        UtilityFunctions::print("Warning: Cannot map Godot keycode 0x", String::num_int64(godot_keycode, 16), " to X11 keycode");
         return;
     }
 
-    if (xtest_available) {
-        // Use XTest extension for realistic keyboard events (bypasses synthetic event detection)
-        // This works for terminals and other security-conscious applications
-        XTestFakeKeyEvent(display, x11_keycode, pressed ? True : False, CurrentTime);
-        XFlush(display);
-    } else {
-        // Fallback to XSendEvent (may be ignored by terminals and some apps)
-        // Track modifier state (static since we need to maintain state across calls)
-        static unsigned int modifier_state = 0;
-
-        // Update modifier state based on pressed/released modifiers (Godot 4)
-        if (godot_keycode == 4194325) {  // KEY_SHIFT
-            if (pressed) modifier_state |= ShiftMask;
-            else modifier_state &= ~ShiftMask;
-        }
-        else if (godot_keycode == 4194326) {  // KEY_CTRL
-            if (pressed) modifier_state |= ControlMask;
-            else modifier_state &= ~ControlMask;
-        }
-        else if (godot_keycode == 4194328 || godot_keycode == 4194327) {  // KEY_ALT or KEY_META
-            if (pressed) modifier_state |= Mod1Mask;
-            else modifier_state &= ~Mod1Mask;
-        }
+    // Symbols that only exist on a shifted level (sent without a Shift of their own):
+    // XTest has to hold the real Shift key around the press, XSendEvent just says so
+    bool add_shift = pressed && (needed_modifiers & ShiftMask) && !(key_modifier_state & ShiftMask);
+    unsigned int state = key_modifier_state | needed_modifiers;
 
-        XEvent event;
-        memset(&event, 0, sizeof(event));
-
-        event.type = pressed ? KeyPress : KeyRelease;
-        event.xkey.window = window->xwindow;
-        event.xkey.root = root_window;
-        event.xkey.subwindow = None;
-        event.xkey.time = CurrentTime;
-        event.xkey.x = 0;
-        event.xkey.y = 0;
-        event.xkey.x_root = 0;
-        event.xkey.y_root = 0;
-        event.xkey.state = modifier_state;  // Include modifier state
-        event.xkey.keycode = x11_keycode;
-        event.xkey.same_screen = True;
-
-        XSendEvent(display, window->xwindow, True, KeyPressMask | KeyReleaseMask, &event);
-        XFlush(display);
+    // Modifier keys change the state sent with everything after them
+    unsigned int mask = key_map.modifier_mask(x11_keycode);
+    if (pressed) {
+        key_modifier_state |= mask;
+    } else {
+        key_modifier_state &= ~mask;
+    }
+
+    QueuedInput input;
+    input.type = QUEUED_INPUT_KEY;
+    input.xwindow = window->xwindow;
+    input.x = 0;
+    input.y = 0;
+    input.root_x = 0;
+    input.root_y = 0;
+    input.detail = x11_keycode;
+    input.state = state;
+    input.pressed = pressed;
+
+    // Keys go out right away, after the motion queued before them
+    input_events_received++;
+    if (add_shift && xtest_available && key_map.shift_keycode()) {
+        QueuedInput shift = input;
+        shift.detail = key_map.shift_keycode();
+        queue_input(shift);
+        queue_input(input);
+        shift.pressed = false;
+        queue_input(shift);
+    } else {
+        queue_input(input);
     }
+    flush_input();
 }
 
 void X11Compositor::set_window_focus(int window_id) {
@@ -1081,6 +3075,9 @@ void X11Compositor::set_window_focus(int window_id) {
     // Set input focus to this window
     XSetInputFocus(display, window->xwindow, RevertToParent, CurrentTime);
 
+    // The focused window is captured first when the capture budget is tight
+    focused_xwindow = window->xwindow;
+
     // Raise the window to the top of the stacking order
     XRaiseWindow(display, window->xwindow);
 
@@ -1094,6 +3091,10 @@ void X11Compositor::release_all_keys() {
 
     UtilityFunctions::print("Releasing all keys to prevent stuck key states");
 
+    // Anything still queued has to happen before the releases
+    flush_input();
+    key_modifier_state = 0;
+
     if (xtest_available) {
         // Use XTest to release all potentially pressed keys
         // X11 keycodes range from 8 to 255
@@ -1107,13 +3108,45 @@ void X11Compositor::release_all_keys() {
     }
 }
 
+void X11Compositor::set_input_latency_ms(double latency_ms) {
+    input_latency_usec = (int64_t)(std::max(0.0, latency_ms) * 1000.0);
+}
+
+double X11Compositor::get_input_latency_ms() const {
+    return input_latency_usec / 1000.0;
+}
+
+Dictionary X11Compositor::get_input_stats() {
+    Dictionary stats;
+    stats["latency_ms"] = get_input_latency_ms();
+    stats["events_received"] = (int64_t)input_events_received;  // send_* calls from scripts
+    stats["events_sent"] = (int64_t)input_events_sent;  // X requests they turned into
+    stats["motion_coalesced"] = (int64_t)input_motion_coalesced;  // Superseded before they were sent
+    stats["flushes"] = (int64_t)input_flushes;
+    stats["pending"] = (int)input_queue.size();
+    return stats;
+}
+
+void X11Compositor::set_verify_window_positions(bool enabled) {
+    verify_window_positions = enabled;
+}
+
+bool X11Compositor::is_verify_window_positions_enabled() const {
+    return verify_window_positions;
+}
+
 void X11Compositor::cleanup() {
-    if (!initialized) {
+    // A failed initialize() leaves whatever it got to (Xvfb, connections, the
+    // framebuffer directory) for us to release, so look at what exists rather
+    // than at `initialized`
+    if (!initialized && !display && !capture_display && xephyr_pid <= 0 && framebuffer_dir.empty()) {
         return;
     }
 
     UtilityFunctions::print("Cleaning up X11Compositor...");
 
+    stop_capture_thread();
+
     // Set error handler to ignore cleanup errors
     XErrorHandler old_handler = XSetErrorHandler(ignore_cleanup_errors);
 
@@ -1123,23 +3156,50 @@ void X11Compositor::cleanup() {
         if (damage_available && window->damage) {
             XDamageDestroy(display, window->damage);
         }
+        if (capture_display) {
+            release_capture_resources(window->capture.get());
+        }
+        free_window_textures(window);
         delete window;
     }
     windows.clear();
     xwindow_to_id.clear();
+    damage_to_window.clear();
+    input_queue.clear();
+
+    // The capture thread has stopped, so its connection is ours to tear down
+    if (capture_display) {
+        for (auto &capture : capture_retired) {
+            release_capture_resources(capture.get());
+        }
+        if (damage_parts) {
+            XFixesDestroyRegion(capture_display, damage_parts);
+            damage_parts = None;
+        }
+        XCloseDisplay(capture_display);
+        capture_display = nullptr;
+    }
+    capture_jobs.clear();
+    capture_retired.clear();
 
-    // Restore error handler
+    // Restore error handler (and the one we replaced for the capture connection)
     XSetErrorHandler(old_handler);
+    if (capture_error_display) {
+        XSetErrorHandler(previous_error_handler);
+        capture_error_display = nullptr;
+    }
 
     // Disable composite redirection
-    if (composite_available) {
+    if (composite_available && display) {
         XCompositeUnredirectSubwindows(display, root_window, CompositeRedirectAutomatic);
     }
 
     // Close X11 connection
     if (display) {
+        pending_titles.clear();  // Their replies go with the connection
         XCloseDisplay(display);
         display = nullptr;
+        xcb_connection = nullptr;
     }
 
     // Kill Xvfb process
@@ -1167,6 +3227,15 @@ void X11Compositor::cleanup() {
         xephyr_pid = 0;
     }
 
+    // Xvfb is gone, so its framebuffer file can go too
+    framebuffer.close();
+    stacking.clear();
+    if (!framebuffer_dir.empty()) {
+        unlink((framebuffer_dir + "/Xvfb_screen0").c_str());
+        rmdir(framebuffer_dir.c_str());
+        framebuffer_dir.clear();
+    }
+
     initialized = false;
     UtilityFunctions::print("X11Compositor cleanup complete");
 }
@@ -1186,4 +3255,160 @@ void X11Compositor::resize_window(int window_id, int width, int height) {
     // Update our cached window size
     window->width = width;
     window->height = height;
+    window->capture->size = ((uint32_t)width << 16) | (uint32_t)height;
+    window->capture->pixmap_generation++;
+    capture_wanted = true;
+}
+
+void X11Compositor::set_window_interest(int window_id, WindowInterest interest) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return;
+    }
+
+    WindowCapture *capture = it->second->capture.get();
+    int previous = capture->interest.exchange(interest);
+    if (previous != interest && interest != WINDOW_INTEREST_HIDDEN) {
+        // Catch up on whatever was damaged while nobody was looking
+        capture_wanted = true;
+    }
+}
+
+X11Compositor::WindowInterest X11Compositor::get_window_interest(int window_id) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return WINDOW_INTEREST_HIDDEN;
+    }
+    return (WindowInterest)it->second->capture->interest.load();
+}
+
+void X11Compositor::set_window_lod(int window_id, int max_pixels, double max_fps) {
+    auto it = windows.find(window_id);
+    if (it == windows.end()) {
+        return;
+    }
+
+    WindowCapture *capture = it->second->capture.get();
+    uint32_t pixels = (uint32_t)std::max(0, max_pixels);
+    int64_t interval = max_fps > 0.0 ? (int64_t)(1000000.0 / max_fps) : 0;
+
+    uint32_t previous_pixels = capture->lod_max_pixels.exchange(pixels);
+    int64_t previous_interval = capture->lod_interval_usec.exchange(interval);
+    if (previous_pixels != pixels || previous_interval > interval) {
+        // Recapture at the new resolution (or sooner, at the higher rate)
+        capture_wanted = true;
+    }
+}
+
+void X11Compositor::set_thumbnail_max_size(int max_size) {
+    thumbnail_max_size = std::max(1, max_size);
+}
+
+int X11Compositor::get_thumbnail_max_size() const {
+    return thumbnail_max_size;
+}
+
+void X11Compositor::set_thumbnail_fps(double fps) {
+    thumbnail_interval_usec = fps > 0.0 ? (int64_t)(1000000.0 / fps) : 0;
+}
+
+double X11Compositor::get_thumbnail_fps() const {
+    int64_t interval = thumbnail_interval_usec;
+    return interval > 0 ? 1000000.0 / interval : 0.0;
+}
+
+void X11Compositor::set_capture_budget_ms(double budget_ms) {
+    capture_budget_usec = (int64_t)(std::max(0.0, budget_ms) * 1000.0);
+}
+
+double X11Compositor::get_capture_budget_ms() const {
+    return capture_budget_usec.load() / 1000.0;
+}
+
+Dictionary X11Compositor::get_capture_stats() {
+    Dictionary stats;
+    stats["budget_ms"] = get_capture_budget_ms();
+    stats["backlog"] = capture_backlog.load();  // Damaged windows deferred to the next pass
+    stats["last_pass_ms"] = last_capture_pass_usec.load() / 1000.0;
+    stats["pixmap_recreations"] = (int64_t)pixmap_recreations.load();  // Should stay flat while windows only repaint
+    stats["framebuffer_captures"] = (int64_t)framebuffer_captures.load();  // Captures read off the Xvfb screen
+    stats["shm_segment_reuses"] = (int64_t)shm_segment_reuses.load();
+    stats["unchanged_tiles"] = (int64_t)unchanged_tiles.load();  // Repainted with identical contents
+    stats["unchanged_captures"] = (int64_t)unchanged_captures.load();  // Not published, so not uploaded
+    stats["texture_full_uploads"] = (int64_t)texture_full_uploads;
+    stats["texture_tile_uploads"] = (int64_t)texture_tile_uploads;  // 64x64 tiles uploaded on their own
+    stats["texture_upload_bytes"] = (int64_t)texture_upload_bytes;
+    stats["position_mismatches"] = (int64_t)position_mismatches;  // Only counted with verify_window_positions
+
+    // Frame buffer pool. Misses should stop growing once window sizes settle,
+    // even while a window is being resized.
+    BufferPool &pool = BufferPool::shared();
+    stats["buffer_pool_hits"] = (int64_t)pool.get_hits();
+    stats["buffer_pool_misses"] = (int64_t)pool.get_misses();
+    stats["buffer_pool_idle_bytes"] = (int64_t)pool.get_idle_bytes();
+    stats["buffer_pool_outstanding_bytes"] = (int64_t)pool.get_outstanding_bytes();
+
+    int hidden = 0;
+    int thumbnails = 0;
+    for (auto &pair : windows) {
+        int interest = pair.second->capture->interest;
+        hidden += interest == WINDOW_INTEREST_HIDDEN;
+        thumbnails += interest == WINDOW_INTEREST_THUMBNAIL;
+    }
+    stats["hidden_windows"] = hidden;        // Not captured at all
+    stats["thumbnail_windows"] = thumbnails;  // Captured at a reduced rate
+    stats["pixel_kernels"] = String(pixel_convert_kernel_name());
+    return stats;
+}
+
+void X11Compositor::set_frame_memory_budget_mb(int budget_mb) {
+    frame_memory_budget = (int64_t)std::max(0, budget_mb) * 1024 * 1024;
+
+    // Idle pooled buffers count against the same memory; keep a quarter of the
+    // budget for them (the default 512MB budget gives the pool's default 128MB)
+    int64_t budget = frame_memory_budget.load();
+    BufferPool::shared().set_max_idle_bytes(budget > 0 ? (size_t)budget / 4 : BufferPool::DEFAULT_MAX_IDLE_BYTES);
+}
+
+int X11Compositor::get_frame_memory_budget_mb() const {
+    return (int)(frame_memory_budget.load() / (1024 * 1024));
+}
+
+Dictionary X11Compositor::get_memory_stats() {
+    static const char *state_names[] = { "warm", "compressed", "dropped" };
+
+    Dictionary per_window;
+    int64_t resident_total = 0;
+    int64_t compressed_total = 0;
+    for (auto &pair : windows) {
+        X11Window *window = pair.second;
+        WindowCapture *capture = window->capture.get();
+
+        // The capture thread accounts for its buffers; add what the main thread holds
+        int64_t resident = capture->resident_bytes;
+        const CaptureFrame &front = capture->frames[capture->front];
+        if (capture->memory_state != FRAME_MEMORY_WARM) {
+            resident += front.pixels.capacity();
+        }
+        if (window->image.is_valid()) {
+            resident += (int64_t)window->image->get_width() * window->image->get_height() * 4;
+        }
+        int64_t compressed = capture->compressed_bytes;
+
+        Dictionary entry;
+        entry["state"] = state_names[capture->memory_state];
+        entry["resident_bytes"] = resident;
+        entry["compressed_bytes"] = compressed;
+        per_window[window->id] = entry;
+
+        resident_total += resident;
+        compressed_total += compressed;
+    }
+
+    Dictionary stats;
+    stats["budget_bytes"] = (int64_t)frame_memory_budget.load();
+    stats["resident_bytes"] = resident_total;
+    stats["compressed_bytes"] = compressed_total;
+    stats["windows"] = per_window;
+    return stats;
 }
@@ -2,7 +2,13 @@
 #define X11_COMPOSITOR_HPP
 
 // Include standard library headers FIRST
-#include <map>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 // Include X11 headers BEFORE Godot to avoid name collision with godot::Window
@@ -11,6 +17,9 @@
 #include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xrender.h>
 #include <X11/extensions/XTest.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/Xlib-xcb.h>
 
 // Typedef X11 types immediately after X11 headers, BEFORE Godot headers
 typedef ::Window X11WindowHandle;
@@ -19,27 +28,181 @@ typedef ::Damage X11Damage;
 // Now include Godot headers
 #include <godot_cpp/classes/node.hpp>
 #include <godot_cpp/classes/image.hpp>
+#include <godot_cpp/classes/image_texture.hpp>
+#include <godot_cpp/classes/rendering_device.hpp>
+#include <godot_cpp/classes/texture2drd.hpp>
 #include <godot_cpp/variant/vector2i.hpp>
+#include <godot_cpp/variant/rect2i.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
 #include <godot_cpp/variant/typed_array.hpp>
 
+#include "buffer_pool.hpp"
+#include "flat_hash_map.hpp"
+#include "key_map.hpp"
+#include "window_query.hpp"
+#include "x11_atoms.hpp"
+#include "xvfb_framebuffer.hpp"
+
 namespace godot {
 
+// Where a frame's pixels came from
+enum CaptureBackend {
+    CAPTURE_BACKEND_XGETIMAGE,       // XGetImage round trips on the composite pixmap
+    CAPTURE_BACKEND_SHM,             // MIT-SHM transfer from the composite pixmap
+    CAPTURE_BACKEND_FRAMEBUFFER,     // Read straight off the mapped Xvfb screen
+};
+
+// What the capture thread is holding for a window under the frame memory budget
+enum FrameMemoryState {
+    FRAME_MEMORY_WARM,               // Full frame and triple buffer resident
+    FRAME_MEMORY_COMPRESSED,         // Frame parked in cold_data, buffers released
+    FRAME_MEMORY_DROPPED,            // Nothing kept; the next capture is a full one
+};
+
+// A captured frame handed from the capture thread to the main thread
+struct CaptureFrame {
+    // RGBA8 window contents, from the buffer pool so a window that keeps resizing
+    // reuses the same few buffers. The main thread copies the changed regions into
+    // its own Image, which is why `rects` has to cover everything since its last frame.
+    PooledBuffer pixels;
+    int width = 0;
+    int height = 0;
+    uint64_t sequence = 0;           // Capture sequence this frame holds (0 = empty)
+    std::vector<XRectangle> rects;   // Regions changed since the last frame the main thread took
+    CaptureBackend backend = CAPTURE_BACKEND_XGETIMAGE;  // How the latest pixels were read
+};
+
+// Per-window capture state shared between the main thread and the capture thread
+struct WindowCapture {
+    X11WindowHandle xwindow;
+    X11Damage damage;
+    Visual *visual;                  // Window visual (needed to create SHM images)
+    int depth;                       // Window depth
+    bool has_alpha = false;          // ARGB visual (premultiplied alpha is converted, not dropped)
+
+    // Written by the main thread, read by the capture thread
+    std::atomic<bool> mapped{false};
+    std::atomic<bool> damaged{false};   // Damage pending since last capture
+    std::atomic<uint32_t> size{0};      // width << 16 | height
+    std::atomic<uint64_t> last_viewed_frame{0};  // Main thread frame that last fetched this window
+    std::atomic<int> interest{0};       // X11Compositor::WindowInterest
+    std::atomic<uint32_t> lod_max_pixels{0};     // Capture resolution cap (0 = full resolution)
+    std::atomic<int64_t> lod_interval_usec{0};   // Minimum time between captures (0 = unlimited)
+    std::atomic<uint32_t> pixmap_generation{0};  // Bumped on map/resize, when the named pixmap goes stale
+    std::atomic<int> memory_state{FRAME_MEMORY_WARM};  // FrameMemoryState, written by the capture thread
+    std::atomic<uint64_t> resident_bytes{0};     // Approximate uncompressed frame memory
+    std::atomic<uint64_t> compressed_bytes{0};   // Size of cold_data
+    std::atomic<uint64_t> framebuffer_placement{0};  // Screen position of unobscured contents (see FRAMEBUFFER_PLACEMENT_VALID), 0 = use the pixmap
+    std::atomic<uint64_t> thumbnail_request_frame{0};  // Frame that last asked for a thumbnail, plus one (0 = never)
+
+    // Downscaled preview, produced by the capture thread while someone asks for it.
+    // Small enough that handing it over under a mutex is cheaper than another triple buffer.
+    std::mutex thumbnail_mutex;
+    PackedByteArray thumbnail_pixels;  // RGBA8
+    int thumbnail_width = 0;
+    int thumbnail_height = 0;
+    uint64_t thumbnail_sequence = 0;   // Capture sequence the thumbnail was made from (0 = none)
+
+    // Lock-free triple buffer. The capture thread fills frames[back] and swaps it
+    // with the middle slot; the main thread swaps a fresh middle into frames[front].
+    CaptureFrame frames[3];
+    std::atomic<uint8_t> middle{1};  // Index of the middle frame, plus CAPTURE_FRAME_FRESH
+    uint8_t back = 0;                // Capture thread only
+    uint8_t front = 2;               // Main thread only
+
+    // Capture thread only
+    PooledBuffer image_data;         // Latest full frame (frames are brought up to date from it)
+    int image_width = 0;
+    int image_height = 0;
+    uint64_t sequence = 0;           // Sequence of the latest published frame
+    uint64_t last_capture_pass = 0;  // Capture pass that last serviced this window (for fairness)
+    int64_t last_capture_usec = 0;   // steady_clock time of the last capture (thumbnail throttling)
+    int64_t last_thumbnail_usec = 0; // steady_clock time the thumbnail was last regenerated
+    std::deque<std::pair<uint64_t, std::vector<XRectangle>>> history;  // Rects per recent sequence
+    std::vector<XRectangle> carried_rects;  // Rects of frames the main thread never took
+    XShmSegmentInfo shm_info;        // Persistent MIT-SHM segment for captures
+    XImage *shm_image = nullptr;     // SHM-backed XImage (nullptr if not using SHM)
+    XImage *shm_sub_image = nullptr; // Second header on the segment, resized to each damage box
+    size_t shm_capacity = 0;         // Segment size, a BufferPool size class so resizes can reuse it
+    Pixmap pixmap = None;            // Persistent composite pixmap (XCompositeNameWindowPixmap)
+    uint32_t pixmap_named_generation = 0;  // pixmap_generation `pixmap` was named at
+    Picture pixmap_picture = None;   // XRender picture of `pixmap` (LOD scaling source)
+    Pixmap scaled_pixmap = None;     // Persistent LOD scaling target
+    Picture scaled_picture = None;
+    int scaled_width = 0;
+    int scaled_height = 0;
+    std::vector<XRectangle> framebuffer_recheck;  // Rects read off the screen last pass, read once more
+    bool unsupported_format = false;  // convert_image_rect can't read its pixels; never captured again
+    std::vector<uint8_t> cold_data;  // Compressed image_data while FRAME_MEMORY_COMPRESSED
+    std::vector<uint32_t> tile_hashes;  // CRC32C per CAPTURE_TILE_SIZE tile of the last published frame
+    std::vector<uint8_t> tile_touched;  // Scratch: tiles overlapped by this capture's rects
+    int tile_hash_width = 0;         // Image size tile_hashes were computed for
+    int tile_hash_height = 0;
+    CaptureBackend last_backend = CAPTURE_BACKEND_XGETIMAGE;  // Backend of the latest published frame
+};
+
+// A child of the root window, in stacking order (framebuffer capture backend)
+struct StackedWindow {
+    X11WindowHandle xwindow;
+    int x, y;
+    int width, height;
+    int border;
+    bool mapped;
+};
+
+// Injected input waiting for the next flush (see X11Compositor::queue_input)
+enum QueuedInputType {
+    QUEUED_INPUT_MOTION,
+    QUEUED_INPUT_BUTTON,
+    QUEUED_INPUT_KEY,
+};
+
+struct QueuedInput {
+    QueuedInputType type;
+    X11WindowHandle xwindow;  // Target for the XSendEvent fallback
+    int x, y;                 // Window-relative pointer position
+    int root_x, root_y;
+    unsigned int detail;      // Button number or X keycode
+    unsigned int state;       // Modifier mask (XSendEvent fallback only)
+    bool pressed;
+};
+
 // Structure to track X11 windows
 struct X11Window {
     int id;                          // Our internal ID
     X11WindowHandle xwindow;         // X11 window handle
     int width;
     int height;
-    int x, y;                        // Window position
+    int x, y;                        // Position inside parent_xwindow
+    int border;                      // Border width
+    X11WindowHandle parent_xwindow;  // X parent: the root, or a window manager frame
+    int parent_origin_x;             // Root position of parent_xwindow's inside, so the
+    int parent_origin_y;             // window's root position is origin + x/y + border
     X11Damage damage;                // Damage tracking
     bool mapped;                     // Is window currently mapped
-    std::vector<uint8_t> image_data; // Cached window contents
-    bool has_image;                  // Whether we have valid image data
     String wm_class;                 // Window class (application identifier)
     String wm_name;                  // Window title
     int pid;                         // Process ID
     int parent_window_id;            // Parent window ID (-1 if no parent)
     bool is_dialog;                  // Is this a dialog/menu/utility window
+    std::shared_ptr<WindowCapture> capture;  // Shared with the capture thread
+    Ref<Image> image;                // Persistent image handed out by get_window_buffer, updated in place
+    uint64_t image_sequence;         // Capture sequence `image` currently shows
+    Ref<ImageTexture> texture;       // Persistent texture handed out by get_window_texture
+    uint64_t texture_sequence;       // Capture sequence `texture` (or `tiled_texture`) currently shows
+    Ref<Texture2DRD> tiled_texture;  // Used instead of `texture` when there's a RenderingDevice
+    RID texture_rid;                 // RenderingDevice texture behind tiled_texture
+    RID staging_rid;                 // One-tile texture dirty tiles are uploaded through
+    int texture_width;
+    int texture_height;
+    std::vector<uint8_t> dirty_tiles;  // TEXTURE_TILE_SIZE tiles changed since the texture was updated
+    int tile_columns;
+    int tile_rows;
+    Ref<ImageTexture> thumbnail;     // Persistent texture handed out by get_window_thumbnail
+    uint64_t thumbnail_sequence;     // Capture sequence `thumbnail` was made from
+    std::vector<XRectangle> updated_rects;   // Regions refreshed since scripts last asked
 };
 
 class X11Compositor : public Node {
@@ -48,6 +211,11 @@ class X11Compositor : public Node {
 private:
     // X11 connection and state
     Display *display;
+    xcb_connection_t *xcb_connection;  // XCB side of `display`, for pipelined queries
+    std::vector<std::pair<X11WindowHandle, xcb_get_property_cookie_t>> pending_titles;  // WM_NAME reads in flight, oldest first
+    X11Atoms atoms;                    // Interned once in initialize()
+    KeyMap key_map;                    // Built in initialize(), rebuilt on MappingNotify
+    unsigned int key_modifier_state;   // Modifiers our injected keys are holding down
     X11WindowHandle root_window;
     int screen;
     int display_number;  // Display number we're using (:1, :2, etc.)
@@ -66,9 +234,95 @@ private:
     // XTest extension (for realistic input events)
     bool xtest_available;
 
+    // MIT-SHM extension (for zero-copy window capture)
+    bool shm_available;
+    bool shm_rejected;  // Capture thread only: the server refused an XShmAttach (remote or containerised)
+
+    // XFixes extension (for fetching damage regions)
+    bool xfixes_available;
+
+    // XRender extension (for server-side downscaling of low-LOD captures)
+    bool render_available;
+
+    // Xvfb framebuffer capture backend. Xvfb exports its screen as a file that we
+    // map; windows nothing overlaps are read straight off it, everything else falls
+    // back to the composite pixmap. Only the main thread touches `stacking`.
+    bool framebuffer_capture;            // Requested before initialize()
+    std::string framebuffer_dir;         // -fbdir directory we created for Xvfb
+    XvfbFramebuffer framebuffer;         // Read by the capture thread once open
+    std::vector<StackedWindow> stacking; // Root children, bottom to top
+    bool stacking_dirty;
+    bool framebuffer_recheck_pending;    // Capture thread only
+    std::atomic<uint64_t> framebuffer_captures;
+
+    // Capture thread. It has its own X connection so pixel transfers never
+    // block the main thread; frames come back through WindowCapture triple buffers.
+    Display *capture_display;
+    XserverRegion damage_parts;  // Scratch region for XDamageSubtract (capture_display)
+    std::thread capture_thread;
+    std::atomic<bool> capture_running;
+    std::mutex capture_mutex;    // Guards the fields below
+    std::condition_variable capture_cv;
+    bool capture_requested;
+    std::vector<std::shared_ptr<WindowCapture>> capture_jobs;
+    std::vector<std::shared_ptr<WindowCapture>> capture_retired;  // Removed windows awaiting cleanup
+
+    // Capture scheduling. Damage is coalesced per window and the main thread wakes
+    // the capture thread at most once per frame; each pass captures in priority order
+    // (focused, then recently displayed windows) until the time budget runs out, and
+    // defers the rest to the next pass.
+    bool capture_wanted;                       // Main thread: something changed this frame
+    std::atomic<uint64_t> frame_counter;       // Incremented every _process
+    std::atomic<int64_t> capture_budget_usec;  // Per-pass budget (0 = unlimited)
+    std::atomic<X11WindowHandle> focused_xwindow;
+    std::atomic<int> capture_backlog;          // Windows deferred by the last pass
+    std::atomic<uint64_t> pixmap_recreations;  // Named/scaled pixmaps created (flat in steady state)
+    std::atomic<uint64_t> shm_segment_reuses;  // SHM images resized within their existing segment
+    std::atomic<uint64_t> unchanged_tiles;     // Captured tiles whose contents hashed the same as before
+    std::atomic<uint64_t> unchanged_captures;  // Captures that changed nothing and weren't published
+    std::atomic<int64_t> last_capture_pass_usec;
+    uint64_t capture_pass;                     // Capture thread only
+
+    // Frame memory budget. Windows nobody has looked at for a while get their
+    // frames compressed (or dropped, if hidden) by the capture thread once the
+    // total goes over budget; they're restored when someone asks again.
+    std::atomic<int64_t> frame_memory_budget;  // Bytes (0 = unlimited)
+
+    // Texture upload accounting (main thread)
+    uint64_t texture_full_uploads;
+    uint64_t texture_tile_uploads;
+    uint64_t texture_upload_bytes;
+
+    // Thumbnail channel settings
+    std::atomic<int> thumbnail_max_size;        // Longest thumbnail edge in pixels
+    std::atomic<int64_t> thumbnail_interval_usec;  // Minimum time between thumbnail refreshes
+
+    // Window metadata snapshot. window_generation is bumped whenever anything the
+    // snapshot reports changes; the snapshot is rebuilt lazily when it's behind.
+    uint64_t window_generation;
+    uint64_t window_snapshot_generation;
+    Dictionary window_snapshot;
+
+    // Root positions are kept up to date from ConfigureNotify/ReparentNotify rather
+    // than asked of the server. The debug mode checks each lookup with a round trip.
+    bool verify_window_positions;
+    uint64_t position_mismatches;
+
+    // Input injection queue. Motion is coalesced to the latest position and sent
+    // once per frame (or when the oldest pending event reaches the latency target);
+    // buttons and keys flush the queue right away, after the motion before them.
+    std::vector<QueuedInput> input_queue;
+    int64_t input_queued_usec;      // When the oldest pending event was queued
+    int64_t input_latency_usec;     // 0 = flush every frame
+    uint64_t input_events_received;
+    uint64_t input_events_sent;     // Requests actually sent to the X server
+    uint64_t input_motion_coalesced;
+    uint64_t input_flushes;
+
     // Window tracking
-    std::map<int, X11Window*> windows;
-    std::map<unsigned long, int> xwindow_to_id;  // Reverse lookup (X11 Window is unsigned long)
+    FlatHashMap<int, X11Window*> windows;
+    FlatHashMap<unsigned long, int> xwindow_to_id;  // Reverse lookup (X11 Window is unsigned long)
+    FlatHashMap<unsigned long, X11Window*> damage_to_window;  // Damage handle -> window, for damage events
     int next_window_id;
 
     // State
@@ -84,16 +338,73 @@ private:
     void handle_map_notify(XMapEvent *event);
     void handle_unmap_notify(XUnmapEvent *event);
     void handle_configure_notify(XConfigureEvent *event);
+    void handle_reparent_notify(XReparentEvent *event);
+    void move_frame_children(X11WindowHandle frame, int origin_x, int origin_y);
+    Vector2i window_root_position(X11Window *window);
+    static Vector2i cached_root_position(const X11Window *window);  // No verification
+    void emit_window_moved(X11Window *window);  // window_moved carries the root position
+    void queue_input(const QueuedInput &input);
+    void send_input(const QueuedInput &input);
+    void flush_input();
     void handle_damage_notify(XDamageNotifyEvent *event);
-    void capture_window_contents(X11Window *window);
-    void add_window(X11WindowHandle xwin);
+    void handle_property_notify(XPropertyEvent *event);
+    void receive_titles();
+    void start_capture_thread();
+    void stop_capture_thread();
+    void request_capture();
+    void capture_thread_main();
+    bool needs_capture(WindowCapture *capture, int64_t *next_capture_usec = nullptr);  // Sets the deadline of a rate-limited skip
+    void update_thumbnail(WindowCapture *capture, int64_t now_usec);
+    void get_capture_size(WindowCapture *capture, int width, int height, int *capture_width, int *capture_height);
+    Pixmap update_scaled_pixmap(WindowCapture *capture, int source_width, int source_height,
+                                int width, int height);
+    void destroy_capture_pixmaps(WindowCapture *capture);
+    bool capture_from_framebuffer(WindowCapture *capture, uint64_t placement,
+                                  std::vector<XRectangle> &rects, bool full_capture);
+    void enforce_memory_budget(const std::vector<std::shared_ptr<WindowCapture>> &captures);
+    void make_cold(WindowCapture *capture, bool drop);
+    void restore_frame(WindowCapture *capture, bool publish);
+    void update_memory_accounting(WindowCapture *capture);
+    void release_cold_frames();
+    void track_stacking(XEvent *event);
+    void update_framebuffer_placement();
+    void release_capture_resources(WindowCapture *capture);
+    void capture_window_contents(WindowCapture *capture);
+    bool drop_unchanged_tiles(WindowCapture *capture, std::vector<XRectangle> &rects, bool *full_capture);
+    void publish_frame(WindowCapture *capture, const std::vector<XRectangle> &rects,
+                       bool full_capture, CaptureBackend backend);
+    CaptureFrame *acquire_frame(X11Window *window);
+    void mark_dirty_tiles(X11Window *window, const CaptureFrame &frame);
+    Ref<Texture2D> update_tiled_texture(X11Window *window, const Ref<Image> &image, RenderingDevice *rd);
+    void free_window_textures(X11Window *window);
+    bool create_shm_image(WindowCapture *capture);
+    void destroy_shm_image(WindowCapture *capture);
+    bool query_window(X11WindowHandle xwin, WindowInfo *info);
+    Visual *find_visual(VisualID visual_id);
+    void add_window(X11WindowHandle xwin, const WindowInfo &info);
     void remove_window(X11WindowHandle xwin);
-    bool should_track_window(X11WindowHandle xwin);
+    bool should_track_window(const WindowInfo &info);
 
 protected:
     static void _bind_methods();
 
 public:
+    // How much scripts care about a window's contents. Hidden windows are not captured
+    // at all; their damage keeps accumulating so the first frame after re-showing is
+    // complete. Thumbnail-only windows are captured at a reduced rate.
+    enum WindowInterest {
+        WINDOW_INTEREST_VISIBLE,
+        WINDOW_INTEREST_THUMBNAIL,
+        WINDOW_INTEREST_HIDDEN,
+    };
+
+    // Bits of the "flags" array in get_window_snapshot()
+    enum WindowSnapshotFlags {
+        WINDOW_SNAPSHOT_MAPPED = 1,
+        WINDOW_SNAPSHOT_DIALOG = 2,
+        WINDOW_SNAPSHOT_TRANSPARENT = 4,
+    };
+
     X11Compositor();
     ~X11Compositor();
 
@@ -104,8 +415,14 @@ public:
 
     // Public API exposed to GDScript (matching old WaylandCompositor API)
     bool initialize();
+    void set_framebuffer_capture_enabled(bool enabled);  // Takes effect at initialize()
+    bool is_framebuffer_capture_enabled() const;
     TypedArray<int> get_window_ids();
-    Ref<Image> get_window_buffer(int window_id);
+    int64_t get_window_generation() const;  // Changes whenever get_window_snapshot() would
+    Dictionary get_window_snapshot();  // Metadata of every window in one call, reused until the generation changes
+    Ref<Image> get_window_buffer(int window_id);  // Same Image every call (updated in place) - treat as read-only
+    Ref<Texture2D> get_window_texture(int window_id);  // Same texture every call, uploaded only when the window changed
+    Ref<Texture2D> get_window_thumbnail(int window_id);  // Downscaled preview, refreshed at thumbnail_fps
     Vector2i get_window_size(int window_id);
     String get_display_name();
     bool is_initialized();
@@ -115,9 +432,12 @@ public:
     String get_window_title(int window_id);
     int get_window_pid(int window_id);
     int get_parent_window_id(int window_id);
-    Vector2i get_window_position(int window_id);
+    Vector2i get_window_position(int window_id);  // Root position, no round trip
     bool is_window_mapped(int window_id);
     bool is_window_dialog(int window_id);
+    bool is_window_transparent(int window_id);  // Window has an ARGB visual
+    String get_window_capture_backend(int window_id);
+    TypedArray<Rect2i> get_window_dirty_rects(int window_id);  // Regions updated since last call
 
     // Input handling
     void send_mouse_button(int window_id, int button, bool pressed, int x, int y);
@@ -125,11 +445,40 @@ public:
     void send_key_event(int window_id, int keycode, bool pressed);
     void set_window_focus(int window_id);
     void release_all_keys();  // Release all currently pressed keys
+    void set_input_latency_ms(double latency_ms);  // Longest motion is held back for coalescing
+    double get_input_latency_ms() const;
+    Dictionary get_input_stats();  // Events received from scripts vs requests sent
+    void set_verify_window_positions(bool enabled);  // Debug: check cached positions against the server
+    bool is_verify_window_positions_enabled() const;
 
     // Window manipulation
     void resize_window(int window_id, int width, int height);
+
+    // Capture interest (see WindowInterest)
+    void set_window_interest(int window_id, WindowInterest interest);
+    WindowInterest get_window_interest(int window_id);
+    void set_window_lod(int window_id, int max_pixels, double max_fps);  // 0 = no limit for either
+
+    // Thumbnail channel
+    void set_thumbnail_max_size(int max_size);
+    int get_thumbnail_max_size() const;
+    void set_thumbnail_fps(double fps);
+    double get_thumbnail_fps() const;
+
+    // Capture scheduling
+    void set_capture_budget_ms(double budget_ms);
+    double get_capture_budget_ms() const;
+    Dictionary get_capture_stats();
+
+    // Frame memory budget
+    void set_frame_memory_budget_mb(int budget_mb);
+    int get_frame_memory_budget_mb() const;
+    Dictionary get_memory_stats();  // Totals plus per-window byte counts
 };
 
 } // namespace godot
 
+VARIANT_ENUM_CAST(X11Compositor::WindowInterest);
+VARIANT_ENUM_CAST(X11Compositor::WindowSnapshotFlags);
+
 #endif // X11_COMPOSITOR_HPP
@@ -0,0 +1,104 @@
+#include "xvfb_framebuffer.hpp"
+#include "pixel_convert.hpp"
+
+#include <X11/X.h>
+#include <X11/XWDFile.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace godot {
+
+bool XvfbFramebuffer::open(const std::string &path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sz_XWDheader) {
+        ::close(fd);
+        return false;
+    }
+
+    // Xvfb maps the same file MAP_SHARED, so this mapping sees every update
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    // The XWD header is always most-significant byte first
+    XWDFileHeader header;
+    memcpy(&header, map, sizeof(header));
+    uint32_t *fields = (uint32_t*)&header;
+    for (size_t i = 0; i < sizeof(header) / 4; i++) {
+        fields[i] = ntohl(fields[i]);
+    }
+
+    size_t image_offset = header.header_size + (size_t)header.ncolors * sz_XWDColor;
+    size_t image_size = (size_t)header.bytes_per_line * header.pixmap_height;
+    bool supported = header.file_version == XWD_FILE_VERSION &&
+                     header.pixmap_format == ZPixmap &&
+                     header.bits_per_pixel == 32 &&
+                     header.byte_order == LSBFirst &&
+                     header.visual_class == TrueColor &&
+                     header.red_mask == 0xFF0000 && header.green_mask == 0xFF00 && header.blue_mask == 0xFF &&
+                     image_offset + image_size <= (size_t)st.st_size;
+    if (!supported) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    mapping = map;
+    mapping_size = st.st_size;
+    pixels = (const uint8_t*)map + image_offset;
+    stride = header.bytes_per_line;
+    width = header.pixmap_width;
+    height = header.pixmap_height;
+    depth = header.pixmap_depth;
+    return true;
+}
+
+void XvfbFramebuffer::close() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+    mapping = nullptr;
+    mapping_size = 0;
+    pixels = nullptr;
+    stride = 0;
+    width = 0;
+    height = 0;
+    depth = 0;
+}
+
+bool XvfbFramebuffer::read_rect(int x, int y, int rect_width, int rect_height, uint8_t *dst, size_t dst_stride) {
+    if (!pixels || x < 0 || y < 0 || rect_width <= 0 || rect_height <= 0 ||
+        x + rect_width > width || y + rect_height > height) {
+        return false;
+    }
+
+    size_t row_bytes = (size_t)rect_width * 4;
+    scratch_row.resize(row_bytes);
+
+    bool changed = false;
+    for (int row = 0; row < rect_height; row++) {
+        const uint8_t *src = pixels + (size_t)(y + row) * stride + (size_t)x * 4;
+        pixel_convert_rect(src, row_bytes, scratch_row.data(), row_bytes, rect_width, 1, PIXEL_FORMAT_BGRX);
+
+        uint8_t *out = dst + row * dst_stride;
+        if (memcmp(out, scratch_row.data(), row_bytes) != 0) {
+            memcpy(out, scratch_row.data(), row_bytes);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+} // namespace godot
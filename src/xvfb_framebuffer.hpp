@@ -0,0 +1,49 @@
+#ifndef XVFB_FRAMEBUFFER_HPP
+#define XVFB_FRAMEBUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace godot {
+
+// Read-only mapping of the screen framebuffer Xvfb exports with -fbdir. The file
+// is an XWD image that Xvfb renders into directly, so once mapped, reading
+// window contents off the screen costs no X requests at all.
+class XvfbFramebuffer {
+public:
+    XvfbFramebuffer() {}
+    ~XvfbFramebuffer() { close(); }
+
+    XvfbFramebuffer(const XvfbFramebuffer &) = delete;
+    XvfbFramebuffer &operator=(const XvfbFramebuffer &) = delete;
+
+    // Map the XWD file at `path`. Fails (and stays closed) unless the screen is
+    // 32bpp little-endian TrueColor with the usual x8r8g8b8 masks.
+    bool open(const std::string &path);
+    void close();
+
+    bool is_open() const { return pixels != nullptr; }
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+    int get_depth() const { return depth; }
+
+    // Convert a screen rectangle to RGBA8 at dst, writing only rows that differ
+    // from what dst already holds. Returns whether anything changed.
+    bool read_rect(int x, int y, int rect_width, int rect_height, uint8_t *dst, size_t dst_stride);
+
+private:
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+    const uint8_t *pixels = nullptr;   // First pixel of the image inside the mapping
+    size_t stride = 0;
+    int width = 0;
+    int height = 0;
+    int depth = 0;
+    std::vector<uint8_t> scratch_row;  // Converted row, compared against dst before copying
+};
+
+} // namespace godot
+
+#endif // XVFB_FRAMEBUFFER_HPP